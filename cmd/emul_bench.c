@@ -0,0 +1,177 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <linux/i2c.h>
+#include <smbus/smbus.h>
+
+typedef enum emul_bench_op_t
+{
+    EMUL_BENCH_BYTE,
+    EMUL_BENCH_WORD,
+    EMUL_BENCH_BLOCK,
+}
+emul_bench_op_t;
+
+static const char* emul_bench_op_names[] = { "byte", "word", "block" };
+
+// Adapter functionality each read needs on the native path
+static const unsigned long emul_bench_op_funcs[] = {
+    I2C_FUNC_SMBUS_READ_BYTE_DATA,
+    I2C_FUNC_SMBUS_READ_WORD_DATA,
+    I2C_FUNC_SMBUS_READ_BLOCK_DATA,
+};
+
+
+static uint64_t emul_bench_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static bool emul_bench_read(
+    smbus_handle_t smbus_handle,
+    emul_bench_op_t op,
+    uint8_t command
+)
+{
+    uint8_t block[SMBUS_BLOCK_MAX];
+    uint8_t length = 0;
+    uint16_t word = 0;
+    uint8_t byte = 0;
+
+    switch(op)
+    {
+        case EMUL_BENCH_BYTE:
+            return smbus_read_byte_data(smbus_handle, command, &byte);
+        case EMUL_BENCH_WORD:
+            return smbus_read_word_data(smbus_handle, command, &word);
+        case EMUL_BENCH_BLOCK:
+            return smbus_read_block_data(smbus_handle, command, block, &length);
+    }
+
+    return false;
+}
+
+static void emul_bench_run(
+    smbus_handle_t smbus_handle,
+    const char* path,
+    emul_bench_op_t op,
+    uint8_t command,
+    unsigned long count
+)
+{
+    unsigned long errors = 0;
+    uint64_t max_ns = 0;
+    uint64_t start_ns = emul_bench_ns();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+        uint64_t op_ns = emul_bench_ns();
+
+        if(!emul_bench_read(smbus_handle, op, command))
+        {
+            ++errors;
+        }
+
+        op_ns = emul_bench_ns() - op_ns;
+
+        if(op_ns > max_ns)
+        {
+            max_ns = op_ns;
+        }
+    }
+
+    uint64_t total_ns = emul_bench_ns() - start_ns;
+
+    printf("%-8s %-5s: %lu reads, %lu errors, %llu ns/op, worst %llu ns\n",
+        path,
+        emul_bench_op_names[op],
+        count,
+        errors,
+        (unsigned long long)(count ? total_ns / count : 0),
+        (unsigned long long)max_ns
+    );
+}
+
+// Usage: smbus-emul-bench BUS ADDRESS COMMAND [COUNT] [pec]
+int main(int argc, char* argv[])
+{
+    if(argc < 4)
+    {
+        fprintf(stderr, "Usage: %s BUS ADDRESS COMMAND [COUNT] [pec]\n", argv[0]);
+        return -1;
+    }
+
+    unsigned bus_index = strtoul(argv[1], NULL, 0);
+    uint8_t address = strtoul(argv[2], NULL, 0);
+    uint8_t command = strtoul(argv[3], NULL, 0);
+    unsigned long count = (argc > 4) ? strtoul(argv[4], NULL, 0) : 10000;
+    bool is_pec_enabled = (argc > 5) && strcmp(argv[5], "pec") == 0;
+    unsigned long func_flags = 0;
+
+    // The second handle only keeps plain I2C, every read goes through the emulation
+    smbus_handle_t native_handle = smbus_open(bus_index);
+    smbus_handle_t emul_handle = smbus_open(bus_index);
+
+    if(native_handle == NULL || emul_handle == NULL)
+    {
+        perror("Error opening I2C bus");
+        return -1;
+    }
+
+    smbus_get_funcs(native_handle, &func_flags);
+    smbus_mask_funcs(emul_handle, I2C_FUNC_I2C);
+
+    if(!smbus_use_slave(native_handle, address) || !smbus_use_slave(emul_handle, address))
+    {
+        perror("Error setting slave address");
+        smbus_close(native_handle);
+        smbus_close(emul_handle);
+        return -1;
+    }
+
+    if(is_pec_enabled)
+    {
+        if(!smbus_set_pec(native_handle, true) || !smbus_set_pec(emul_handle, true))
+        {
+            perror("Error enabling PEC");
+            smbus_close(native_handle);
+            smbus_close(emul_handle);
+            return -1;
+        }
+    }
+
+    for(emul_bench_op_t op = EMUL_BENCH_BYTE; op <= EMUL_BENCH_BLOCK; ++op)
+    {
+        bool is_native = (func_flags & emul_bench_op_funcs[op]) != 0 &&
+            (!is_pec_enabled || (func_flags & I2C_FUNC_SMBUS_PEC));
+
+        if(is_native)
+        {
+            emul_bench_run(native_handle, "native", op, command, count);
+        }
+        else
+        {
+            printf("%-8s %-5s: not supported by the adapter\n", "native", emul_bench_op_names[op]);
+        }
+
+        if(func_flags & I2C_FUNC_I2C)
+        {
+            emul_bench_run(emul_handle, "i2c_rdwr", op, command, count);
+        }
+        else
+        {
+            printf("%-8s %-5s: not supported by the adapter\n", "i2c_rdwr", emul_bench_op_names[op]);
+        }
+    }
+
+    smbus_close(native_handle);
+    smbus_close(emul_handle);
+
+    return 0;
+}
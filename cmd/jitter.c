@@ -0,0 +1,170 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <smbus/smbus.h>
+#include "commands.h"
+
+#define PICO_I2C_BUS_NUMBER 0
+#define PICO_I2C_SLAVE_ADDRESS 0x17
+
+// 1 kHz control loop
+#define JITTER_PERIOD_NS 1000000L
+#define JITTER_REPORT_S 60
+// Latency histogram in 10 us buckets, the last one collects everything above
+#define JITTER_BUCKET_NS 10000
+#define JITTER_BUCKETS 100
+
+
+static uint64_t jitter_ns(
+    const struct timespec* ts
+)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static void jitter_report(
+    const uint64_t* histogram,
+    uint64_t cycles,
+    uint64_t max_ns,
+    uint64_t max_late_ns,
+    uint64_t errors
+)
+{
+    printf("cycles %llu errors %llu worst latency %llu us worst wakeup %llu us\n",
+        (unsigned long long)cycles,
+        (unsigned long long)errors,
+        (unsigned long long)(max_ns / 1000),
+        (unsigned long long)(max_late_ns / 1000)
+    );
+
+    for(size_t i = 0; i < JITTER_BUCKETS; ++i)
+    {
+        if(histogram[i] != 0)
+        {
+            printf("  %s%4zu us: %llu\n",
+                (i == JITTER_BUCKETS - 1) ? ">=" : "< ",
+                (i == JITTER_BUCKETS - 1) ? i * JITTER_BUCKET_NS / 1000 : (i + 1) * JITTER_BUCKET_NS / 1000,
+                (unsigned long long)histogram[i]
+            );
+        }
+    }
+
+    fflush(stdout);
+}
+
+// Usage: smbus_jitter [duration_s] [rt_priority] [rt_cpu]
+int main(int argc, char* argv[])
+{
+    unsigned long duration_s = (argc > 1) ? strtoul(argv[1], NULL, 0) : 3600;
+    smbus_rt_config_t rt_config = {
+        .priority = (argc > 2) ? atoi(argv[2]) : 80,
+        .cpu = (argc > 3) ? atoi(argv[3]) : -1,
+        .stack_size = 0,
+        .lock_memory = true,
+    };
+    uint64_t histogram[JITTER_BUCKETS];
+    uint64_t cycles = 0;
+    uint64_t errors = 0;
+    uint64_t max_ns = 0;
+    uint64_t max_late_ns = 0;
+
+    memset(histogram, 0, sizeof(histogram));
+
+    smbus_handle_t smbus_handle = smbus_open(PICO_I2C_BUS_NUMBER);
+
+    if(smbus_handle == NULL)
+    {
+        perror("Error opening I2C bus");
+        return -1;
+    }
+
+    if(!smbus_use_slave(smbus_handle, PICO_I2C_SLAVE_ADDRESS))
+    {
+        perror("Error setting slave address");
+        return -1;
+    }
+
+    if(!smbus_rt_start(smbus_handle, &rt_config))
+    {
+        perror("Error starting real-time mode");
+        return -1;
+    }
+
+    // The loop thread faults its own stack in as well, the worker already did
+    smbus_rt_prefault_stack(64 * 1024);
+
+    printf("Measuring for %lu s, priority %d, cpu %d\n", duration_s, rt_config.priority, rt_config.cpu);
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+
+    uint64_t end_ns = jitter_ns(&next) + (uint64_t)duration_s * 1000000000ULL;
+    uint64_t report_ns = jitter_ns(&next) + (uint64_t)JITTER_REPORT_S * 1000000000ULL;
+
+    for(;;)
+    {
+        struct timespec start;
+        struct timespec stop;
+        uint8_t value = 0;
+
+        next.tv_nsec += JITTER_PERIOD_NS;
+
+        if(next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            ++next.tv_sec;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+
+        if(!smbus_read_byte_data(smbus_handle, SMBUS_CMD_BYTE_DATA, &value))
+        {
+            ++errors;
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &stop);
+
+        uint64_t late_ns = jitter_ns(&start) - jitter_ns(&next);
+        uint64_t latency_ns = jitter_ns(&stop) - jitter_ns(&start);
+        size_t bucket = latency_ns / JITTER_BUCKET_NS;
+
+        ++histogram[(bucket < JITTER_BUCKETS) ? bucket : JITTER_BUCKETS - 1];
+        ++cycles;
+
+        if(latency_ns > max_ns)
+        {
+            max_ns = latency_ns;
+        }
+
+        if(late_ns > max_late_ns)
+        {
+            max_late_ns = late_ns;
+        }
+
+        if(jitter_ns(&stop) >= report_ns)
+        {
+            jitter_report(histogram, cycles, max_ns, max_late_ns, errors);
+            report_ns += (uint64_t)JITTER_REPORT_S * 1000000000ULL;
+        }
+
+        if(jitter_ns(&stop) >= end_ns)
+        {
+            break;
+        }
+    }
+
+    jitter_report(histogram, cycles, max_ns, max_late_ns, errors);
+
+    smbus_rt_stop(smbus_handle);
+
+    if(!smbus_close(smbus_handle))
+    {
+        perror("Error closing I2C bus");
+        return -1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdint.h>
+#include <errno.h>
+#include <smbus/smbus_log.h>
+
+
+// Usage: smbus_log2csv LOG_FILE > samples.csv
+int main(int argc, char* argv[])
+{
+    smbus_log_sample_t sample;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s LOG_FILE\n", argv[0]);
+        return -1;
+    }
+
+    smbus_log_reader_t log_reader = smbus_log_reader_open(argv[1]);
+
+    if(log_reader == NULL)
+    {
+        perror("Error opening log");
+        return -1;
+    }
+
+    printf("timestamp_ns,series,address,command,value\n");
+
+    while(smbus_log_reader_next(log_reader, &sample))
+    {
+        const smbus_log_series_t* series = smbus_log_reader_series(log_reader, sample.series);
+
+        printf("%llu,%s,0x%02X,0x%02X,%llu\n",
+            (unsigned long long)sample.timestamp_ns,
+            (series != NULL) ? series->name : "?",
+            (series != NULL) ? series->address : 0,
+            (series != NULL) ? series->command : 0,
+            (unsigned long long)sample.value
+        );
+    }
+
+    int error = errno;
+    smbus_log_reader_close(log_reader);
+
+    if(error != 0)
+    {
+        errno = error;
+        perror("Error reading log");
+        return -1;
+    }
+
+    return 0;
+}
@@ -3,6 +3,7 @@
 #include <string.h>
 #include <smbus/smbus.h>
 #include "commands.h"
+#include "test_device.h"
 
 #define PICO_I2C_BUS_NUMBER 0
 #define PICO_I2C_SLAVE_ADDRESS 0x17
@@ -248,6 +249,26 @@ int main(int argc, char* argv[])
         }
     }
 
+    // SNAPSHOT 
+    {
+        test_device_snapshot_t snapshot;
+        memset(&snapshot, 0, sizeof(test_device_snapshot_t));
+
+        if(smbus_device_read_all(smbus_handle, test_device_desc(), &snapshot))
+        {
+            printf("[OK] SNAPSHOT: BYTE 0x%02X WORD 0x%04X DWORD 0x%08X BLOCK (%u)\n",
+                snapshot.byte_data,
+                snapshot.word_data,
+                snapshot.dword_data,
+                snapshot.block_data.length
+            );
+        }
+        else
+        {
+            perror("[ER] SNAPSHOT");
+        }
+    }
+
     if(!smbus_close(smbus_handle))
     {
         perror("Error closing I2C bus");
@@ -0,0 +1,200 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <math.h>
+#include <smbus/pmbus.h>
+
+// Every 16 bit word is decoded
+#define PMBUS_BENCH_WORDS 65536
+
+typedef enum pmbus_bench_format_t
+{
+    PMBUS_BENCH_LINEAR11,
+    PMBUS_BENCH_LINEAR16,
+    PMBUS_BENCH_DIRECT,
+}
+pmbus_bench_format_t;
+
+static const char* pmbus_bench_format_names[] = { "linear11", "linear16", "direct" };
+
+// Exponent -13 in VOUT_MODE, a common 122 uV resolution
+static const uint8_t pmbus_bench_vout_mode = 0x13;
+
+// Coefficients with a non zero offset and a negative R
+static const pmbus_direct_t pmbus_bench_direct = { .m = 25, .b = -200, .r = -2 };
+
+
+static uint64_t pmbus_bench_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static void pmbus_bench_vector(
+    pmbus_bench_format_t format,
+    const uint16_t* raw,
+    float* values
+)
+{
+    switch(format)
+    {
+        case PMBUS_BENCH_LINEAR11:
+            pmbus_decode_linear11(raw, values, PMBUS_BENCH_WORDS);
+            break;
+        case PMBUS_BENCH_LINEAR16:
+            pmbus_decode_linear16(raw, values, PMBUS_BENCH_WORDS, pmbus_bench_vout_mode);
+            break;
+        case PMBUS_BENCH_DIRECT:
+            pmbus_decode_direct(raw, values, PMBUS_BENCH_WORDS, &pmbus_bench_direct);
+            break;
+    }
+}
+
+// Factors of the scalar DIRECT baseline, computed once like the vector path does
+static float pmbus_bench_direct_scale;
+static float pmbus_bench_direct_offset;
+
+static void pmbus_bench_direct_factors(void)
+{
+    // X = (Y * 10^-R - b) / m
+    float power = 1.0f;
+
+    for(int8_t r = pmbus_bench_direct.r; r > 0; --r)
+    {
+        power /= 10.0f;
+    }
+
+    for(int8_t r = pmbus_bench_direct.r; r < 0; ++r)
+    {
+        power *= 10.0f;
+    }
+
+    pmbus_bench_direct_scale = power / pmbus_bench_direct.m;
+    pmbus_bench_direct_offset = -(float)pmbus_bench_direct.b / pmbus_bench_direct.m;
+}
+
+static void pmbus_bench_scalar(
+    pmbus_bench_format_t format,
+    const uint16_t* raw,
+    float* values
+)
+{
+    for(size_t i = 0; i < PMBUS_BENCH_WORDS; ++i)
+    {
+        switch(format)
+        {
+            case PMBUS_BENCH_LINEAR11:
+                values[i] = pmbus_linear11_to_float(raw[i]);
+                break;
+            case PMBUS_BENCH_LINEAR16:
+                values[i] = pmbus_linear16_to_float(raw[i], pmbus_bench_vout_mode);
+                break;
+            case PMBUS_BENCH_DIRECT:
+                values[i] = (int16_t)raw[i] * pmbus_bench_direct_scale + pmbus_bench_direct_offset;
+                break;
+        }
+    }
+}
+
+static unsigned long pmbus_bench_compare(
+    pmbus_bench_format_t format,
+    const uint16_t* raw,
+    const float* vector,
+    const float* scalar
+)
+{
+    unsigned long mismatches = 0;
+
+    for(size_t i = 0; i < PMBUS_BENCH_WORDS; ++i)
+    {
+        // Bit for bit, any NaN only matches another NaN
+        bool is_equal = memcmp(&vector[i], &scalar[i], sizeof(float)) == 0 ||
+            (isnan(vector[i]) && isnan(scalar[i]));
+
+        if(!is_equal)
+        {
+            if(mismatches == 0)
+            {
+                printf("%-8s: 0x%04X decodes to %.9g, scalar %.9g\n",
+                    pmbus_bench_format_names[format],
+                    raw[i],
+                    vector[i],
+                    scalar[i]
+                );
+            }
+
+            ++mismatches;
+        }
+    }
+
+    return mismatches;
+}
+
+// Usage: smbus-pmbus-bench [COUNT]
+int main(int argc, char* argv[])
+{
+    unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000;
+    uint16_t* raw = malloc(PMBUS_BENCH_WORDS * sizeof(uint16_t));
+    float* vector = malloc(PMBUS_BENCH_WORDS * sizeof(float));
+    float* scalar = malloc(PMBUS_BENCH_WORDS * sizeof(float));
+    unsigned long failures = 0;
+
+    if(raw == NULL || vector == NULL || scalar == NULL)
+    {
+        perror("Error allocating buffers");
+        free(raw);
+        free(vector);
+        free(scalar);
+        return -1;
+    }
+
+    for(size_t i = 0; i < PMBUS_BENCH_WORDS; ++i)
+    {
+        raw[i] = (uint16_t)i;
+    }
+
+    pmbus_bench_direct_factors();
+
+    for(pmbus_bench_format_t format = PMBUS_BENCH_LINEAR11; format <= PMBUS_BENCH_DIRECT; ++format)
+    {
+        uint64_t vector_ns = 0;
+        uint64_t scalar_ns = 0;
+
+        for(unsigned long i = 0; i < count; ++i)
+        {
+            uint64_t start_ns = pmbus_bench_ns();
+            pmbus_bench_vector(format, raw, vector);
+            vector_ns += pmbus_bench_ns() - start_ns;
+
+            start_ns = pmbus_bench_ns();
+            pmbus_bench_scalar(format, raw, scalar);
+            scalar_ns += pmbus_bench_ns() - start_ns;
+        }
+
+        // Checked after the timed rounds too, so COUNT 0 only verifies
+        pmbus_bench_vector(format, raw, vector);
+        pmbus_bench_scalar(format, raw, scalar);
+
+        unsigned long mismatches = pmbus_bench_compare(format, raw, vector, scalar);
+        uint64_t values = (uint64_t)count * PMBUS_BENCH_WORDS;
+
+        printf("%-8s: %lu mismatches, vector %.3f ns/value, scalar %.3f ns/value\n",
+            pmbus_bench_format_names[format],
+            mismatches,
+            values ? (double)vector_ns / values : 0.0,
+            values ? (double)scalar_ns / values : 0.0
+        );
+
+        failures += mismatches;
+    }
+
+    free(raw);
+    free(vector);
+    free(scalar);
+
+    return (failures == 0) ? 0 : -1;
+}
@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <smbus/smbus.h>
+
+
+static uint64_t rp1_bench_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+static smbus_handle_t rp1_bench_open(
+    const char* mode,
+    const char* target,
+    uint8_t address
+)
+{
+    if(strcmp(mode, "ioctl") == 0)
+    {
+        return smbus_open(strtoul(target, NULL, 0));
+    }
+
+    if(strcmp(mode, "rp1") == 0)
+    {
+        unsigned bus_index = strtoul(target, NULL, 0);
+
+        return smbus_open_rp1(bus_index, "/dev/mem", SMBUS_RP1_I2C_BASE(bus_index));
+    }
+
+    if(strcmp(mode, "emul") == 0)
+    {
+        smbus_handle_t smbus_handle = smbus_open_rp1_emul(target);
+
+        if(smbus_handle != NULL && !smbus_rp1_emul_add_device(smbus_handle, address, false))
+        {
+            smbus_close(smbus_handle);
+            return NULL;
+        }
+
+        return smbus_handle;
+    }
+
+    fprintf(stderr, "Unknown mode %s\n", mode);
+
+    errno = EINVAL;
+    return NULL;
+}
+
+// Usage: smbus-rp1-bench ioctl|rp1|emul BUS|FILE ADDRESS COMMAND [COUNT]
+int main(int argc, char* argv[])
+{
+    if(argc < 5)
+    {
+        fprintf(stderr, "Usage: %s ioctl|rp1|emul BUS|FILE ADDRESS COMMAND [COUNT]\n", argv[0]);
+        return -1;
+    }
+
+    uint8_t address = strtoul(argv[3], NULL, 0);
+    uint8_t command = strtoul(argv[4], NULL, 0);
+    unsigned long count = (argc > 5) ? strtoul(argv[5], NULL, 0) : 10000;
+    unsigned long errors = 0;
+    uint64_t max_ns = 0;
+
+    smbus_handle_t smbus_handle = rp1_bench_open(argv[1], argv[2], address);
+
+    if(smbus_handle == NULL)
+    {
+        perror("Error opening I2C bus");
+        return -1;
+    }
+
+    if(!smbus_use_slave(smbus_handle, address))
+    {
+        perror("Error setting slave address");
+        smbus_close(smbus_handle);
+        return -1;
+    }
+
+    uint64_t start_ns = rp1_bench_ns();
+
+    for(unsigned long i = 0; i < count; ++i)
+    {
+        uint64_t op_ns = rp1_bench_ns();
+        uint16_t word = 0;
+
+        if(!smbus_read_word_data(smbus_handle, command, &word))
+        {
+            ++errors;
+        }
+
+        op_ns = rp1_bench_ns() - op_ns;
+
+        if(op_ns > max_ns)
+        {
+            max_ns = op_ns;
+        }
+    }
+
+    uint64_t total_ns = rp1_bench_ns() - start_ns;
+
+    printf("%s: %lu word reads, %lu errors, %llu ns/op, worst %llu ns\n",
+        argv[1],
+        count,
+        errors,
+        (unsigned long long)(count ? total_ns / count : 0),
+        (unsigned long long)max_ns
+    );
+
+    smbus_close(smbus_handle);
+
+    return (errors == 0) ? 0 : -1;
+}
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <smbus/smbus.h>
+#include <smbus/smbus_arena.h>
+#include <smbus/smbus_arp.h>
+
+#define RP1_EMUL_CHECK_ADDRESS 0x17
+// Plain device outside ARP, on an address of the ARP pool
+#define RP1_EMUL_CHECK_PLAIN_ADDRESS 0x30
+#define RP1_EMUL_CHECK_FIXED_ADDRESS 0x22
+#define RP1_EMUL_CHECK_PERSISTENT_ADDRESS 0x23
+#define RP1_EMUL_CHECK_ARP_DYNAMIC 3
+#define RP1_EMUL_CHECK_ARP_DEVICES (RP1_EMUL_CHECK_ARP_DYNAMIC + 2)
+
+
+static unsigned rp1_emul_check_failures = 0;
+
+static void rp1_emul_check(
+    bool is_ok,
+    bool is_pec_enabled,
+    const char* what
+)
+{
+    if(!is_ok)
+    {
+        printf("FAIL %s%s\n", what, is_pec_enabled ? " (PEC)" : "");
+        ++rp1_emul_check_failures;
+    }
+}
+
+// Several reads of one device in one batch, each a transaction of its own
+static void rp1_emul_check_reads(
+    smbus_handle_t smbus_handle,
+    uint8_t* memory,
+    bool is_pec_enabled
+)
+{
+    smbus_arena_handle_t arena = smbus_arena_create(3);
+    smbus_arena_read_t reads[] = {
+        { .address = RP1_EMUL_CHECK_ADDRESS, .command = 0x10, .length = 1 },
+        { .address = RP1_EMUL_CHECK_ADDRESS, .command = 0x20, .length = 2 },
+        { .address = RP1_EMUL_CHECK_ADDRESS, .command = 0x30, .length = 1 },
+    };
+    smbus_view_t views[3];
+
+    if(arena == NULL)
+    {
+        rp1_emul_check(false, is_pec_enabled, "arena create");
+        return;
+    }
+
+    bool is_ok = smbus_arena_read(smbus_handle, arena, reads, 3, views);
+
+    rp1_emul_check(is_ok, is_pec_enabled, "batched reads");
+
+    if(is_ok)
+    {
+        rp1_emul_check(views[0].data[0] == 0x10, is_pec_enabled, "read of 0x10");
+        rp1_emul_check(views[1].data[0] == 0x20 && views[1].data[1] == 0x21, is_pec_enabled, "read of 0x20");
+        rp1_emul_check(views[2].data[0] == 0x30, is_pec_enabled, "read of 0x30");
+    }
+
+    // The command bytes of later reads must not be stored as data
+    rp1_emul_check(memory[0x12] == 0x12 && memory[0x14] == 0x14, is_pec_enabled, "memory untouched by reads");
+
+    smbus_arena_destroy(arena);
+}
+
+// Read-modify-write of two registers of one device, the writes batched
+static void rp1_emul_check_writes(
+    smbus_handle_t smbus_handle,
+    uint8_t* memory,
+    bool is_pec_enabled
+)
+{
+    smbus_update_t updates[] = {
+        { .command = 0x50, .mask = 0xFF, .value = 0x22 },
+        { .command = 0x52, .is_word = true, .mask = 0xFFFF, .value = 0x4433 },
+    };
+
+    memory[0x50] = 0x00;
+    memory[0x51] = 0x11;
+    memory[0x52] = 0x00;
+    memory[0x53] = 0x00;
+
+    rp1_emul_check(smbus_update_group(smbus_handle, updates, 2), is_pec_enabled, "batched writes");
+    rp1_emul_check(memory[0x50] == 0x22, is_pec_enabled, "write of 0x50");
+    rp1_emul_check(memory[0x51] == 0x11, is_pec_enabled, "register between the writes");
+    rp1_emul_check(memory[0x52] == 0x33 && memory[0x53] == 0x44, is_pec_enabled, "write of 0x52");
+}
+
+// Every device of the table answers at its address
+static bool rp1_emul_check_arp_answers(
+    smbus_handle_t smbus_handle,
+    const smbus_arp_table_t* table
+)
+{
+    for(size_t i = 0; i < table->count; ++i)
+    {
+        smbus_arp_device_t device;
+
+        if(!smbus_arp_get_udid_directed(smbus_handle, table->devices[i].address, &device) ||
+            memcmp(device.udid, table->devices[i].udid, SMBUS_ARP_UDID_LEN) != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// ARP devices of every address type next to plain devices, enumerated, saved, loaded and restored
+static void rp1_emul_check_arp(
+    const char* path
+)
+{
+    char table_path[256];
+    uint8_t udids[RP1_EMUL_CHECK_ARP_DEVICES][SMBUS_ARP_UDID_LEN];
+    // Starts with both plain devices, which the enumeration must skip
+    const uint8_t pool[] = { RP1_EMUL_CHECK_ADDRESS, RP1_EMUL_CHECK_PLAIN_ADDRESS, 0x40, 0x41, 0x42, 0x43 };
+    smbus_arp_table_t table;
+    smbus_arp_table_t loaded;
+
+    snprintf(table_path, sizeof(table_path), "%s.arp", path);
+    unlink(path);
+
+    smbus_handle_t smbus_handle = smbus_open_rp1_emul(path);
+
+    if(smbus_handle == NULL ||
+        !smbus_rp1_emul_add_device(smbus_handle, RP1_EMUL_CHECK_ADDRESS, false) ||
+        !smbus_rp1_emul_add_device(smbus_handle, RP1_EMUL_CHECK_PLAIN_ADDRESS, true))
+    {
+        rp1_emul_check(false, false, "ARP emulator");
+        smbus_close(smbus_handle);
+        return;
+    }
+
+    memset(udids, 0, sizeof(udids));
+
+    for(unsigned i = 0; i < RP1_EMUL_CHECK_ARP_DEVICES; ++i)
+    {
+        uint8_t address = SMBUS_ARP_NO_ADDRESS;
+
+        // Address type in the top bits of the first byte, the last byte tells them apart
+        udids[i][0] = SMBUS_ARP_DYNAMIC_VOLATILE << 6;
+        udids[i][SMBUS_ARP_UDID_LEN - 1] = RP1_EMUL_CHECK_ARP_DEVICES - i;
+
+        if(i == RP1_EMUL_CHECK_ARP_DYNAMIC)
+        {
+            udids[i][0] = SMBUS_ARP_FIXED << 6;
+            address = RP1_EMUL_CHECK_FIXED_ADDRESS;
+        }
+        else if(i == RP1_EMUL_CHECK_ARP_DYNAMIC + 1)
+        {
+            udids[i][0] = SMBUS_ARP_DYNAMIC_PERSISTENT << 6;
+            address = RP1_EMUL_CHECK_PERSISTENT_ADDRESS;
+        }
+
+        rp1_emul_check(smbus_rp1_emul_add_arp_device(smbus_handle, udids[i], address), false, "ARP device add");
+    }
+
+    memset(&table, 0, sizeof(table));
+
+    rp1_emul_check(smbus_arp_enumerate(smbus_handle, &table, pool, sizeof(pool)), false, "ARP enumerate");
+    rp1_emul_check(table.count == RP1_EMUL_CHECK_ARP_DEVICES, false, "ARP devices found");
+
+    for(size_t i = 0; i < table.count; ++i)
+    {
+        uint8_t address = table.devices[i].address;
+        unsigned address_type = SMBUS_ARP_ADDRESS_TYPE(table.devices[i].udid);
+
+        rp1_emul_check(address != RP1_EMUL_CHECK_ADDRESS && address != RP1_EMUL_CHECK_PLAIN_ADDRESS, false, "ARP address of a plain device");
+        rp1_emul_check(address_type != SMBUS_ARP_FIXED || address == RP1_EMUL_CHECK_FIXED_ADDRESS, false, "ARP fixed address");
+        rp1_emul_check(address_type != SMBUS_ARP_DYNAMIC_PERSISTENT || address == RP1_EMUL_CHECK_PERSISTENT_ADDRESS, false, "ARP persistent address");
+
+        for(size_t j = 0; j < i; ++j)
+        {
+            rp1_emul_check(table.devices[j].address != address, false, "ARP unique addresses");
+        }
+    }
+
+    rp1_emul_check(rp1_emul_check_arp_answers(smbus_handle, &table), false, "ARP devices at their addresses");
+
+    rp1_emul_check(smbus_arp_table_save(&table, table_path), false, "ARP table save");
+    rp1_emul_check(smbus_arp_table_load(&loaded, table_path), false, "ARP table load");
+    rp1_emul_check(loaded.count == table.count, false, "ARP table round trip");
+
+    for(size_t i = 0; i < loaded.count && i < table.count; ++i)
+    {
+        rp1_emul_check(memcmp(loaded.devices[i].udid, table.devices[i].udid, SMBUS_ARP_UDID_LEN) == 0 &&
+            loaded.devices[i].address == table.devices[i].address, false, "ARP table entry round trip");
+    }
+
+    // Volatile devices forget their address on reset, restore gives them the table ones
+    rp1_emul_check(smbus_arp_reset_device(smbus_handle), false, "ARP reset device");
+    rp1_emul_check(smbus_arp_restore(smbus_handle, &loaded), false, "ARP restore");
+    rp1_emul_check(rp1_emul_check_arp_answers(smbus_handle, &loaded), false, "ARP devices at their restored addresses");
+
+    smbus_close(smbus_handle);
+
+    unlink(table_path);
+}
+
+// Usage: smbus-rp1-emul-check FILE
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        fprintf(stderr, "Usage: %s FILE\n", argv[0]);
+        return -1;
+    }
+
+    for(int is_pec_enabled = 0; is_pec_enabled < 2; ++is_pec_enabled)
+    {
+        // Every pass starts from a fresh emulator
+        unlink(argv[1]);
+
+        smbus_handle_t smbus_handle = smbus_open_rp1_emul(argv[1]);
+
+        if(smbus_handle == NULL ||
+            !smbus_rp1_emul_add_device(smbus_handle, RP1_EMUL_CHECK_ADDRESS, is_pec_enabled) ||
+            !smbus_use_slave(smbus_handle, RP1_EMUL_CHECK_ADDRESS) ||
+            !smbus_set_pec(smbus_handle, is_pec_enabled))
+        {
+            perror("Error opening the emulator");
+            return -1;
+        }
+
+        uint8_t* memory = smbus_rp1_emul_memory(smbus_handle, RP1_EMUL_CHECK_ADDRESS);
+
+        for(unsigned i = 0; i < 256; ++i)
+        {
+            memory[i] = i;
+        }
+
+        rp1_emul_check_reads(smbus_handle, memory, is_pec_enabled);
+        rp1_emul_check_writes(smbus_handle, memory, is_pec_enabled);
+
+        smbus_close(smbus_handle);
+    }
+
+    rp1_emul_check_arp(argv[1]);
+
+    unlink(argv[1]);
+
+    printf("%u failures\n", rp1_emul_check_failures);
+
+    return (rp1_emul_check_failures == 0) ? 0 : -1;
+}
@@ -0,0 +1,20 @@
+#ifndef TEST_DEVICE_H
+#define TEST_DEVICE_H
+
+#include "commands.h"
+
+// SMBUS TEST DEVICE REGISTERS
+//    name          command                 type    access  volatility  scale
+
+#define TEST_DEVICE_REGS(X)                                                     \
+    X(byte_data,    SMBUS_CMD_BYTE_DATA,    BYTE,   RW,     VOLATILE,   1.0f)   \
+    X(word_data,    SMBUS_CMD_WORD_DATA,    WORD,   RW,     VOLATILE,   1.0f)   \
+    X(dword_data,   SMBUS_CMD_DWORD_DATA,   DWORD,  RW,     VOLATILE,   1.0f)   \
+    X(qword_data,   SMBUS_CMD_QWORD_DATA,   QWORD,  RW,     VOLATILE,   1.0f)   \
+    X(block_data,   SMBUS_CMD_BLOCK_DATA,   BLOCK,  RW,     STATIC,     1.0f)
+
+#define SMBUS_DEVICE_NAME test_device
+#define SMBUS_DEVICE_REGS TEST_DEVICE_REGS
+#include <smbus/smbus_device_gen.h>
+
+#endif // TEST_DEVICE_H
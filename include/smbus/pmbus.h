@@ -0,0 +1,175 @@
+#ifndef PMBUS_H
+#define PMBUS_H
+
+#include <smbus/smbus.h>
+#include <stddef.h>
+
+// PMBUS STANDARD COMMANDS LIST
+
+#define PMBUS_PAGE                  0x00
+#define PMBUS_OPERATION             0x01
+#define PMBUS_ON_OFF_CONFIG         0x02
+#define PMBUS_CLEAR_FAULTS          0x03
+#define PMBUS_PHASE                 0x04
+#define PMBUS_WRITE_PROTECT         0x10
+#define PMBUS_CAPABILITY            0x19
+#define PMBUS_VOUT_MODE             0x20
+#define PMBUS_VOUT_COMMAND          0x21
+#define PMBUS_VOUT_TRIM             0x22
+#define PMBUS_VOUT_MAX              0x24
+#define PMBUS_COEFFICIENTS          0x30
+#define PMBUS_VOUT_OV_FAULT_LIMIT   0x40
+#define PMBUS_VOUT_UV_FAULT_LIMIT   0x44
+#define PMBUS_IOUT_OC_FAULT_LIMIT   0x46
+#define PMBUS_OT_FAULT_LIMIT        0x4F
+#define PMBUS_OT_WARN_LIMIT         0x51
+#define PMBUS_VIN_OV_FAULT_LIMIT    0x55
+#define PMBUS_VIN_UV_FAULT_LIMIT    0x59
+#define PMBUS_STATUS_BYTE           0x78
+#define PMBUS_STATUS_WORD           0x79
+#define PMBUS_STATUS_VOUT           0x7A
+#define PMBUS_STATUS_IOUT           0x7B
+#define PMBUS_STATUS_INPUT          0x7C
+#define PMBUS_STATUS_TEMPERATURE    0x7D
+#define PMBUS_STATUS_CML            0x7E
+#define PMBUS_READ_VIN              0x88
+#define PMBUS_READ_IIN              0x89
+#define PMBUS_READ_VCAP             0x8A
+#define PMBUS_READ_VOUT             0x8B
+#define PMBUS_READ_IOUT             0x8C
+#define PMBUS_READ_TEMPERATURE_1    0x8D
+#define PMBUS_READ_TEMPERATURE_2    0x8E
+#define PMBUS_READ_TEMPERATURE_3    0x8F
+#define PMBUS_READ_FAN_SPEED_1      0x90
+#define PMBUS_READ_DUTY_CYCLE       0x94
+#define PMBUS_READ_FREQUENCY        0x95
+#define PMBUS_READ_POUT             0x96
+#define PMBUS_READ_PIN              0x97
+#define PMBUS_REVISION              0x98
+#define PMBUS_MFR_ID                0x99
+#define PMBUS_MFR_MODEL             0x9A
+#define PMBUS_MFR_REVISION          0x9B
+
+#define PMBUS_PAGE_MAX              0x1F
+#define PMBUS_PAGE_ALL              0xFF
+// Not a PMBus page, commands are sent without touching PAGE
+#define PMBUS_PAGE_NONE             0xFE
+
+#define PMBUS_VOUT_MODE_LINEAR      0x00
+#define PMBUS_VOUT_MODE_VID         0x01
+#define PMBUS_VOUT_MODE_DIRECT      0x02
+
+
+typedef void* pmbus_handle_t;
+
+typedef struct pmbus_direct_t
+{
+    int16_t m;
+    int16_t b;
+    int8_t r;
+}
+pmbus_direct_t;
+
+
+// Each call holds the SMBus handle (smbus_lock) across the slave switch, the PAGE write
+// and the command, so the handle may be shared with other users of the bus
+pmbus_handle_t pmbus_open(
+    smbus_handle_t smbus_handle,
+    uint8_t address
+);
+bool pmbus_close(
+    pmbus_handle_t pmbus_handle
+);
+// Forgets the cached PAGE and VOUT_MODE values, e.g. after the device was reset
+bool pmbus_invalidate(
+    pmbus_handle_t pmbus_handle
+);
+
+bool pmbus_set_page(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page
+);
+bool pmbus_get_vout_mode(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t* vout_mode
+);
+
+bool pmbus_read_byte(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint8_t* byte
+);
+bool pmbus_write_byte(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint8_t byte
+);
+bool pmbus_read_word(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint16_t* word
+);
+bool pmbus_write_word(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint16_t word
+);
+
+bool pmbus_read_linear11(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    float* value
+);
+bool pmbus_read_direct(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    const pmbus_direct_t* coefficients,
+    float* value
+);
+// Decodes READ_VOUT according to the cached VOUT_MODE (LINEAR16 only)
+bool pmbus_read_vout(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    float* value
+);
+
+
+float pmbus_linear11_to_float(
+    uint16_t raw
+);
+float pmbus_linear16_to_float(
+    uint16_t raw,
+    uint8_t vout_mode
+);
+float pmbus_direct_to_float(
+    uint16_t raw,
+    const pmbus_direct_t* coefficients
+);
+
+// Batch decoders, vectorised with NEON or SSE2 when available
+void pmbus_decode_linear11(
+    const uint16_t* raw,
+    float* values,
+    size_t count
+);
+void pmbus_decode_linear16(
+    const uint16_t* raw,
+    float* values,
+    size_t count,
+    uint8_t vout_mode
+);
+void pmbus_decode_direct(
+    const uint16_t* raw,
+    float* values,
+    size_t count,
+    const pmbus_direct_t* coefficients
+);
+
+#endif // PMBUS_H
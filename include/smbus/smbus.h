@@ -3,16 +3,152 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define SMBUS_BLOCK_MAX 32
+#define SMBUS_GENERAL_CALL_ADDRESS 0x00
+// Physical address of the RP1 (Raspberry Pi 5) I2C controller n, for /dev/mem
+#define SMBUS_RP1_I2C_BASE(n) (0x1F00070000ULL + (uint64_t)(n) * 0x4000)
+// Standard mode, what the wire cost model assumes until smbus_set_bus_clock
+#define SMBUS_CLOCK_HZ_DEFAULT 100000
+// SCL of the i2c-gpio overlay for its i2c_gpio_delay_us parameter
+#define SMBUS_I2C_GPIO_CLOCK_HZ(delay_us) (1000000 / (4 * (delay_us)))
 
 
 typedef void* smbus_handle_t;
 
+typedef struct smbus_flight_stats_t
+{
+    // Reads which reached the bus
+    uint64_t issued;
+    // Reads served from an in-flight or fresh result of an identical read
+    uint64_t shared;
+}
+smbus_flight_stats_t;
+
+typedef struct smbus_rt_config_t
+{
+    // SCHED_FIFO priority of the bus worker, 0 keeps the default policy
+    int priority;
+    // CPU the worker is pinned to and busy polls on, -1 to leave it unpinned, sleeping
+    // on a futex between transfers
+    int cpu;
+    // Worker stack size, pre-faulted on start, 0 selects the default
+    size_t stack_size;
+    // Lock current and future process pages in memory until the last worker locking
+    // them stops, leave it off when the application locks memory itself
+    bool lock_memory;
+}
+smbus_rt_config_t;
+
+typedef struct smbus_update_t
+{
+    uint8_t command;
+    bool is_word;
+    uint16_t mask;
+    uint16_t value;
+    // Set when the register had to be written
+    bool is_changed;
+}
+smbus_update_t;
+
+typedef struct smbus_bus_stats_t
+{
+    // I2C_SMBUS and I2C_RDWR transfers issued by the handle
+    uint64_t transfers;
+    // START, address, data, PEC, ACK, repeated START and STOP bits
+    uint64_t wire_bits;
+    // Time the bits take at the configured clock
+    uint64_t wire_ns;
+    // Wall time spent in transfers, driver, scheduling and clock stretching included
+    uint64_t busy_ns;
+    // Wall time without a transfer of this handle
+    uint64_t idle_ns;
+    // Since open or the last reset
+    uint64_t elapsed_ns;
+    // wire_ns / elapsed_ns
+    double occupancy;
+    // wire_ns / busy_ns
+    double efficiency;
+}
+smbus_bus_stats_t;
+
+// One register polled at a fixed period
+typedef struct smbus_poll_t
+{
+    // Data bytes, without the count byte of block transfers
+    uint8_t length;
+    bool is_block;
+    bool is_write;
+    uint32_t period_us;
+}
+smbus_poll_t;
+
+typedef struct smbus_plan_t
+{
+    double transfers_per_s;
+    // Wire time needed per second of schedule
+    uint64_t wire_ns_per_s;
+    // Wire time plus the per-transfer overhead measured on the handle so far
+    uint64_t busy_ns_per_s;
+    // busy_ns_per_s of a whole second
+    double occupancy;
+    // Every poll falling due at once, must fit the shortest period
+    uint64_t burst_ns;
+    bool fits;
+}
+smbus_plan_t;
+
+// Called from the bus manager watcher thread when /dev/i2c-N appears or disappears
+typedef void (*smbus_bus_event_t)(
+    unsigned bus_index,
+    bool is_present,
+    void* context
+);
+
 
 smbus_handle_t smbus_open(
     unsigned i2c_bus_number
 );
+// Process-wide bus manager: the bus is opened on first use and stays open, with its
+// adapter functionality, after the last release. Every user of a bus shares one
+// handle, so slave address changes need smbus_lock like any shared handle.
+// The last release resets everything set on the handle except the slave address.
+// Managed handles must be released, smbus_close refuses them with EBUSY.
+smbus_handle_t smbus_acquire(
+    unsigned bus_index
+);
+bool smbus_release(
+    smbus_handle_t smbus_handle
+);
+// Watches /dev with inotify, pooled handles of removed buses are dropped either way
+bool smbus_set_bus_event_callback(
+    smbus_bus_event_t callback,
+    void* context
+);
+// Stops the watcher and closes the pooled handles nobody holds
+void smbus_manager_shutdown(void);
+// Drives the RP1 DesignWare controller from userspace through its mapped registers
+// (offset SMBUS_RP1_I2C_BASE(n) of /dev/mem), the kernel driver must be unbound first
+smbus_handle_t smbus_open_rp1(
+    unsigned bus_index,
+    const char* mem_path,
+    uint64_t offset
+);
+// Same backend against a register-level emulator of the controller kept in a file
+smbus_handle_t smbus_open_rp1_emul(
+    const char* path
+);
+bool smbus_rp1_emul_add_device(
+    smbus_handle_t smbus_handle,
+    uint8_t address,
+    bool is_pec_enabled
+);
+// 256 byte register memory of an emulated device
+uint8_t* smbus_rp1_emul_memory(
+    smbus_handle_t smbus_handle,
+    uint8_t address
+);
 bool smbus_close(
     smbus_handle_t smbus_handle
 );
@@ -20,6 +156,9 @@ bool smbus_use_slave(
     smbus_handle_t smbus_handle,
     uint8_t address
 );
+uint8_t smbus_get_slave(
+    smbus_handle_t smbus_handle
+);
 bool smbus_set_pec(
     smbus_handle_t smbus_handle,
     bool is_enabled
@@ -27,6 +166,95 @@ bool smbus_set_pec(
 bool smbus_get_pec(
     smbus_handle_t smbus_handle
 );
+bool smbus_get_funcs(
+    smbus_handle_t smbus_handle,
+    unsigned long* func_flags
+);
+// Keeps only the given adapter functionality, so transfers outside it are emulated over
+// I2C_RDWR; for measuring or testing the emulation on adapters supporting the native path
+bool smbus_mask_funcs(
+    smbus_handle_t smbus_handle,
+    unsigned long func_flags
+);
+// Identical concurrent reads share one transfer: readers queued on the handle take the
+// result of a read completed after they arrived. Results also stay fresh for freshness_us
+// or until any transfer of the handle writes to the device. Read-modify-write always
+// reads the device. Must not be toggled while other threads use the handle.
+bool smbus_set_single_flight(
+    smbus_handle_t smbus_handle,
+    bool is_enabled,
+    uint32_t freshness_us
+);
+bool smbus_get_single_flight_stats(
+    smbus_handle_t smbus_handle,
+    smbus_flight_stats_t* stats
+);
+// SCL frequency used to turn transferred bits into wire time
+bool smbus_set_bus_clock(
+    smbus_handle_t smbus_handle,
+    uint32_t clock_hz
+);
+uint32_t smbus_get_bus_clock(
+    smbus_handle_t smbus_handle
+);
+bool smbus_get_bus_stats(
+    smbus_handle_t smbus_handle,
+    smbus_bus_stats_t* stats
+);
+bool smbus_reset_bus_stats(
+    smbus_handle_t smbus_handle
+);
+// Predicts the bus load of a polling schedule with the clock and PEC setting of the handle
+bool smbus_plan_schedule(
+    smbus_handle_t smbus_handle,
+    const smbus_poll_t* polls,
+    size_t poll_count,
+    smbus_plan_t* plan
+);
+// Absolute CLOCK_MONOTONIC time in ns for smbus_set_deadline
+uint64_t smbus_deadline_after_us(
+    uint64_t timeout_us
+);
+// Transfers of the calling thread on the handle must finish by deadline_ns, 0 for none.
+// The deadline belongs to the thread, set around an operation or batch: other threads
+// and other jobs sharing a managed handle are not bound by it. A thread holds one
+// deadline, setting it for another handle replaces it. Late transfers fail with ETIME
+// without reaching the bus. The adapter timeout is lowered to the remaining budget for
+// each transfer of the thread and set back to the default for transfers without one,
+// once the deadline has passed, is cleared or the handle closed.
+// The timeout counts in 10 ms units and is rounded up, so a transfer which hangs on the
+// bus may overrun the deadline by up to 10 ms before it fails.
+bool smbus_set_deadline(
+    smbus_handle_t smbus_handle,
+    uint64_t deadline_ns
+);
+uint64_t smbus_get_deadline(
+    smbus_handle_t smbus_handle
+);
+// Fails with ECANCELED every transfer still waiting for the handle and the rest of
+// the batch or smbus_lock sequence in progress, the transfer on the bus completes
+bool smbus_cancel(
+    smbus_handle_t smbus_handle
+);
+// Moves all bus I/O of the handle to a dedicated busy-polling worker thread
+bool smbus_rt_start(
+    smbus_handle_t smbus_handle,
+    const smbus_rt_config_t* config
+);
+bool smbus_rt_stop(
+    smbus_handle_t smbus_handle
+);
+// Touches stack_size bytes of the calling thread stack so later calls do not page fault
+void smbus_rt_prefault_stack(
+    size_t stack_size
+);
+// Holds the handle (and an advisory lock on the bus device) across several calls
+bool smbus_lock(
+    smbus_handle_t smbus_handle
+);
+bool smbus_unlock(
+    smbus_handle_t smbus_handle
+);
 
 bool smbus_quick_command(
     smbus_handle_t smbus_handle,
@@ -92,6 +320,67 @@ bool smbus_write_block_data(
     uint8_t* block,
     uint8_t* length
 );
+bool smbus_update_bits(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint8_t mask,
+    uint8_t value
+);
+bool smbus_update_word_bits(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint16_t mask,
+    uint16_t value
+);
+bool smbus_update_group(
+    smbus_handle_t smbus_handle,
+    smbus_update_t* updates,
+    size_t update_count
+);
+// Same write to every address in as few I2C_RDWR submissions as possible (42 devices each).
+// Adapters refusing messages to different addresses in one submission, like the kernel
+// i2c-designware driver of the RP1, get one submission per device instead; the refusal
+// is detected once per handle. i2c-designware refuses with EINVAL after the first device
+// was written, that device is not written again. status, if given, receives 0 or -errno
+// per address.
+// Devices of a failed submission are written again one by one to find the failing ones,
+// so writes must be idempotent.
+bool smbus_group_write_byte_data(
+    smbus_handle_t smbus_handle,
+    const uint8_t* addresses,
+    size_t address_count,
+    uint8_t command,
+    uint8_t byte,
+    int* status
+);
+bool smbus_group_write_word_data(
+    smbus_handle_t smbus_handle,
+    const uint8_t* addresses,
+    size_t address_count,
+    uint8_t command,
+    uint16_t word,
+    int* status
+);
+bool smbus_group_write_block_data(
+    smbus_handle_t smbus_handle,
+    const uint8_t* addresses,
+    size_t address_count,
+    uint8_t command,
+    const uint8_t* block,
+    uint8_t length,
+    int* status
+);
+// General call write, only for devices which accept it, sent without PEC
+bool smbus_broadcast_write_byte_data(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint8_t byte
+);
+bool smbus_broadcast_write_word_data(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint16_t word
+);
 bool smbus_proc_call(
     smbus_handle_t smbus_handle,
     uint8_t command,
@@ -0,0 +1,61 @@
+#ifndef SMBUS_ARENA_H
+#define SMBUS_ARENA_H
+
+#include <smbus/smbus.h>
+#include <stddef.h>
+
+// Result arena of batched reads. The read messages of a batch point straight
+// into one cache line aligned buffer, so the adapter driver stores the results
+// where the caller reads them: PEC is checked in place and the views returned
+// per read point into the buffer. Each batch reuses the arena from its start,
+// nothing is allocated or copied after smbus_arena_create.
+
+#define SMBUS_ARENA_ALIGN 64
+
+
+typedef void* smbus_arena_handle_t;
+
+typedef struct smbus_arena_read_t
+{
+    uint8_t address;
+    uint8_t command;
+    // 1 byte data, 2 word data, other lengths I2C block reads, ignored for block reads
+    uint8_t length;
+    // SMBus block read, the length comes from the device
+    bool is_block;
+}
+smbus_arena_read_t;
+
+// Valid until the next batch read into the same arena
+typedef struct smbus_view_t
+{
+    // Data as sent on the wire (words LSB first), blocks 8 byte aligned, other reads
+    // aligned to the largest power of two up to 8 not above their length
+    const uint8_t* data;
+    uint8_t length;
+    // 0 or -errno, -EBADMSG for a PEC mismatch
+    int status;
+}
+smbus_view_t;
+
+
+// Room for read_max reads of any kind
+smbus_arena_handle_t smbus_arena_create(
+    size_t read_max
+);
+void smbus_arena_destroy(
+    smbus_arena_handle_t arena_handle
+);
+// Reads of any slave addresses in as few I2C_RDWR submissions as possible, split by
+// address where the adapter refuses mixed ones. Reads of a failed submission not known
+// to be complete are repeated one by one to find the failing ones, so a read may reach
+// its device twice: registers which clear on read do not belong in a batch.
+bool smbus_arena_read(
+    smbus_handle_t smbus_handle,
+    smbus_arena_handle_t arena_handle,
+    const smbus_arena_read_t* reads,
+    size_t read_count,
+    smbus_view_t* views
+);
+
+#endif // SMBUS_ARENA_H
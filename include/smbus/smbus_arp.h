@@ -0,0 +1,115 @@
+#ifndef SMBUS_ARP_H
+#define SMBUS_ARP_H
+
+#include <smbus/smbus.h>
+#include <stddef.h>
+
+// SMBus 2.0 Address Resolution Protocol. ARP capable devices share the device
+// default address and are told apart by their 128-bit UDID: Get UDID is won by
+// the lowest UDID on the wire, Assign Address gives the winner its own address
+// and takes it out of the following rounds. All ARP transfers carry a PEC.
+
+#define SMBUS_ARP_ADDRESS 0x61
+#define SMBUS_ARP_UDID_LEN 16
+#define SMBUS_ARP_DEVICES_MAX 112
+// No address assigned, as reported by Get UDID
+#define SMBUS_ARP_NO_ADDRESS 0xFF
+// Address type in the device capabilities, the first UDID byte
+#define SMBUS_ARP_ADDRESS_TYPE(udid) ((udid)[0] >> 6)
+
+
+typedef enum smbus_arp_command_t
+{
+    SMBUS_ARP_PREPARE = 0x01,
+    SMBUS_ARP_RESET_DEVICE = 0x02,
+    SMBUS_ARP_GET_UDID = 0x03,
+    SMBUS_ARP_ASSIGN_ADDRESS = 0x04,
+}
+smbus_arp_command_t;
+
+typedef enum smbus_arp_address_type_t
+{
+    SMBUS_ARP_FIXED = 0,
+    SMBUS_ARP_DYNAMIC_PERSISTENT = 1,
+    SMBUS_ARP_DYNAMIC_VOLATILE = 2,
+    SMBUS_ARP_RANDOM = 3,
+}
+smbus_arp_address_type_t;
+
+typedef struct smbus_arp_device_t
+{
+    uint8_t udid[SMBUS_ARP_UDID_LEN];
+    uint8_t address;
+    // Answered the last enumeration or restore
+    bool is_present;
+}
+smbus_arp_device_t;
+
+// UDID to address mapping, kept across boots with smbus_arp_table_save
+typedef struct smbus_arp_table_t
+{
+    smbus_arp_device_t devices[SMBUS_ARP_DEVICES_MAX];
+    size_t count;
+}
+smbus_arp_table_t;
+
+
+// General commands to every ARP device, the handle returns to its slave address afterwards
+bool smbus_arp_prepare(
+    smbus_handle_t smbus_handle
+);
+bool smbus_arp_reset_device(
+    smbus_handle_t smbus_handle
+);
+// UDID of the device winning arbitration among those without an assigned address
+bool smbus_arp_get_udid(
+    smbus_handle_t smbus_handle,
+    smbus_arp_device_t* device
+);
+bool smbus_arp_get_udid_directed(
+    smbus_handle_t smbus_handle,
+    uint8_t address,
+    smbus_arp_device_t* device
+);
+bool smbus_arp_assign_address(
+    smbus_handle_t smbus_handle,
+    const uint8_t* udid,
+    uint8_t address
+);
+
+// Prepares all devices and assigns addresses until none is left, in one locked pass.
+// Devices keep the address of their table entry, fixed and persistent devices the one
+// they report, others get the first free one of pool (NULL for every address the SMBus
+// 2.0 address table does not reserve). Pool addresses are probed with Receive Byte
+// first and skipped when a device outside ARP answers. New devices are added to the table.
+bool smbus_arp_enumerate(
+    smbus_handle_t smbus_handle,
+    smbus_arp_table_t* table,
+    const uint8_t* pool,
+    size_t pool_size
+);
+// Assigns the table addresses again without enumerating, a missing device fails
+// the call after the others are done and is marked absent
+bool smbus_arp_restore(
+    smbus_handle_t smbus_handle,
+    smbus_arp_table_t* table
+);
+
+// Text file, one "UDID address" line per device, replaced atomically on save
+bool smbus_arp_table_load(
+    smbus_arp_table_t* table,
+    const char* path
+);
+bool smbus_arp_table_save(
+    const smbus_arp_table_t* table,
+    const char* path
+);
+
+// ARP device on the RP1 emulator, address SMBUS_ARP_NO_ADDRESS until one is assigned
+bool smbus_rp1_emul_add_arp_device(
+    smbus_handle_t smbus_handle,
+    const uint8_t* udid,
+    uint8_t address
+);
+
+#endif // SMBUS_ARP_H
@@ -0,0 +1,141 @@
+#ifndef SMBUS_DEVICE_H
+#define SMBUS_DEVICE_H
+
+#include <smbus/smbus.h>
+#include <stddef.h>
+
+typedef enum smbus_reg_type_t
+{
+    SMBUS_REG_BYTE,
+    SMBUS_REG_WORD,
+    SMBUS_REG_DWORD,
+    SMBUS_REG_QWORD,
+    SMBUS_REG_BLOCK,
+}
+smbus_reg_type_t;
+
+typedef enum smbus_reg_access_t
+{
+    SMBUS_REG_RO = 0x01,
+    SMBUS_REG_WO = 0x02,
+    SMBUS_REG_RW = SMBUS_REG_RO | SMBUS_REG_WO,
+}
+smbus_reg_access_t;
+
+typedef enum smbus_reg_volatility_t
+{
+    SMBUS_REG_STATIC,
+    SMBUS_REG_VOLATILE,
+}
+smbus_reg_volatility_t;
+
+typedef struct smbus_block_t
+{
+    uint8_t length;
+    uint8_t data[SMBUS_BLOCK_MAX];
+}
+smbus_block_t;
+
+typedef struct smbus_reg_desc_t
+{
+    uint8_t command;
+    uint8_t type;
+    uint8_t access;
+    uint8_t volatility;
+    float scale;
+    size_t offset;
+}
+smbus_reg_desc_t;
+
+typedef struct smbus_device_desc_t
+{
+    const char* name;
+    const smbus_reg_desc_t* regs;
+    size_t reg_count;
+}
+smbus_device_desc_t;
+
+typedef void* smbus_device_plan_handle_t;
+
+
+// Reads every readable register of the device into the snapshot. The read messages
+// are prepared on the first call and kept by the handle for the descriptor, which
+// must outlive the handle (generated descriptors are static). Registers are read
+// in command order, the plan addresses a single slave so it never switches address.
+bool smbus_device_read_all(
+    smbus_handle_t smbus_handle,
+    const smbus_device_desc_t* device_desc,
+    void* snapshot
+);
+// Reads only registers marked VOLATILE, static ones keep their snapshot values
+bool smbus_device_read_volatile(
+    smbus_handle_t smbus_handle,
+    const smbus_device_desc_t* device_desc,
+    void* snapshot
+);
+
+// Read messages of the registers selected as above, prepared once for the slave address
+// and PEC setting of the handle. A read after either changed prepares them again.
+smbus_device_plan_handle_t smbus_device_plan_create(
+    smbus_handle_t smbus_handle,
+    const smbus_device_desc_t* device_desc,
+    bool volatile_only
+);
+void smbus_device_plan_destroy(
+    smbus_device_plan_handle_t plan_handle
+);
+bool smbus_device_plan_read(
+    smbus_handle_t smbus_handle,
+    smbus_device_plan_handle_t plan_handle,
+    void* snapshot
+);
+
+
+static inline bool smbus_reg_read_BYTE(smbus_handle_t smbus_handle, uint8_t command, uint8_t* value)
+{
+    return smbus_read_byte_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_write_BYTE(smbus_handle_t smbus_handle, uint8_t command, uint8_t value)
+{
+    return smbus_write_byte_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_read_WORD(smbus_handle_t smbus_handle, uint8_t command, uint16_t* value)
+{
+    return smbus_read_word_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_write_WORD(smbus_handle_t smbus_handle, uint8_t command, uint16_t value)
+{
+    return smbus_write_word_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_read_DWORD(smbus_handle_t smbus_handle, uint8_t command, uint32_t* value)
+{
+    return smbus_read_dword_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_write_DWORD(smbus_handle_t smbus_handle, uint8_t command, uint32_t value)
+{
+    return smbus_write_dword_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_read_QWORD(smbus_handle_t smbus_handle, uint8_t command, uint64_t* value)
+{
+    return smbus_read_qword_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_write_QWORD(smbus_handle_t smbus_handle, uint8_t command, uint64_t value)
+{
+    return smbus_write_qword_data(smbus_handle, command, value);
+}
+static inline bool smbus_reg_read_BLOCK(smbus_handle_t smbus_handle, uint8_t command, smbus_block_t* value)
+{
+    return smbus_read_block_data(smbus_handle, command, value->data, &value->length);
+}
+static inline bool smbus_reg_write_BLOCK(smbus_handle_t smbus_handle, uint8_t command, smbus_block_t value)
+{
+    return smbus_write_block_data(smbus_handle, command, value.data, &value.length);
+}
+
+#define SMBUS_REG_CTYPE_BYTE uint8_t
+#define SMBUS_REG_CTYPE_WORD uint16_t
+#define SMBUS_REG_CTYPE_DWORD uint32_t
+#define SMBUS_REG_CTYPE_QWORD uint64_t
+#define SMBUS_REG_CTYPE_BLOCK smbus_block_t
+
+#endif // SMBUS_DEVICE_H
@@ -0,0 +1,142 @@
+// Device descriptor generator, may be included once per device.
+//
+// Define before including:
+//   SMBUS_DEVICE_NAME - prefix of every generated symbol
+//   SMBUS_DEVICE_REGS - X-macro list of registers, each entry is
+//       X(name, command, type, access, volatility, scale)
+//       type       - BYTE, WORD, DWORD, QWORD or BLOCK
+//       access     - RO, WO or RW
+//       volatility - STATIC or VOLATILE
+//       scale      - multiplier applied by the <name>_scaled getter
+//
+// Generates:
+//   <dev>_snapshot_t                   - struct with a field per readable register
+//   <dev>_desc()                       - descriptor for smbus_device_read_all/_volatile
+//   <dev>_read_<name>, <dev>_write_<name> - typed accessors according to access mode
+//   <dev>_<name>_scaled                - scaled value of a non-block register from the snapshot
+
+#include <smbus/smbus_device.h>
+
+#if !defined(SMBUS_DEVICE_NAME) || !defined(SMBUS_DEVICE_REGS)
+#error "SMBUS_DEVICE_NAME and SMBUS_DEVICE_REGS must be defined"
+#endif
+
+#define SMBUS_GEN_CAT_(a, b) a##b
+#define SMBUS_GEN_CAT(a, b) SMBUS_GEN_CAT_(a, b)
+#define SMBUS_GEN_STR_(a) #a
+#define SMBUS_GEN_STR(a) SMBUS_GEN_STR_(a)
+#define SMBUS_GEN_SYM(suffix) SMBUS_GEN_CAT(SMBUS_DEVICE_NAME, suffix)
+#define SMBUS_GEN_SNAPSHOT SMBUS_GEN_SYM(_snapshot_t)
+
+// Snapshot fields, write-only registers are not part of the snapshot
+#define SMBUS_GEN_FIELD_RO(name, type) SMBUS_REG_CTYPE_##type name;
+#define SMBUS_GEN_FIELD_WO(name, type)
+#define SMBUS_GEN_FIELD_RW(name, type) SMBUS_GEN_FIELD_RO(name, type)
+#define SMBUS_GEN_FIELD(name, command, type, access, volatility, scale) \
+    SMBUS_GEN_FIELD_##access(name, type)
+
+// Register descriptors
+#define SMBUS_GEN_DESC_RO(name, command, type, access, volatility, scale) \
+    { command, SMBUS_REG_##type, SMBUS_REG_##access, SMBUS_REG_##volatility, scale, offsetof(smbus_gen_snapshot_t, name) },
+#define SMBUS_GEN_DESC_WO(name, command, type, access, volatility, scale)
+#define SMBUS_GEN_DESC_RW(name, command, type, access, volatility, scale) \
+    SMBUS_GEN_DESC_RO(name, command, type, access, volatility, scale)
+#define SMBUS_GEN_DESC(name, command, type, access, volatility, scale) \
+    SMBUS_GEN_DESC_##access(name, command, type, access, volatility, scale)
+
+// Typed accessors
+#define SMBUS_GEN_READER(name, command, type)                                   \
+    static inline bool SMBUS_GEN_SYM(SMBUS_GEN_CAT(_read_, name))(             \
+        smbus_handle_t smbus_handle, SMBUS_REG_CTYPE_##type* value)             \
+    {                                                                           \
+        return smbus_reg_read_##type(smbus_handle, command, value);            \
+    }
+#define SMBUS_GEN_WRITER(name, command, type)                                   \
+    static inline bool SMBUS_GEN_SYM(SMBUS_GEN_CAT(_write_, name))(            \
+        smbus_handle_t smbus_handle, SMBUS_REG_CTYPE_##type value)              \
+    {                                                                           \
+        return smbus_reg_write_##type(smbus_handle, command, value);           \
+    }
+#define SMBUS_GEN_ACCESSORS_RO(name, command, type) SMBUS_GEN_READER(name, command, type)
+#define SMBUS_GEN_ACCESSORS_WO(name, command, type) SMBUS_GEN_WRITER(name, command, type)
+#define SMBUS_GEN_ACCESSORS_RW(name, command, type) \
+    SMBUS_GEN_READER(name, command, type)           \
+    SMBUS_GEN_WRITER(name, command, type)
+
+// Scaled getters, only for numeric readable registers
+#define SMBUS_GEN_SCALED_NUM(name, scale)                                       \
+    static inline float SMBUS_GEN_SYM(SMBUS_GEN_CAT(SMBUS_GEN_CAT(_, name), _scaled))( \
+        const SMBUS_GEN_SNAPSHOT* snapshot)                                     \
+    {                                                                           \
+        return (float)snapshot->name * (scale);                                 \
+    }
+#define SMBUS_GEN_SCALED_BYTE(name, scale) SMBUS_GEN_SCALED_NUM(name, scale)
+#define SMBUS_GEN_SCALED_WORD(name, scale) SMBUS_GEN_SCALED_NUM(name, scale)
+#define SMBUS_GEN_SCALED_DWORD(name, scale) SMBUS_GEN_SCALED_NUM(name, scale)
+#define SMBUS_GEN_SCALED_QWORD(name, scale) SMBUS_GEN_SCALED_NUM(name, scale)
+#define SMBUS_GEN_SCALED_BLOCK(name, scale)
+#define SMBUS_GEN_SCALED_RO(name, type, scale) SMBUS_GEN_SCALED_##type(name, scale)
+#define SMBUS_GEN_SCALED_WO(name, type, scale)
+#define SMBUS_GEN_SCALED_RW(name, type, scale) SMBUS_GEN_SCALED_##type(name, scale)
+
+#define SMBUS_GEN_FUNCS(name, command, type, access, volatility, scale) \
+    SMBUS_GEN_ACCESSORS_##access(name, command, type)                   \
+    SMBUS_GEN_SCALED_##access(name, type, scale)
+
+
+typedef struct SMBUS_GEN_SNAPSHOT
+{
+    SMBUS_DEVICE_REGS(SMBUS_GEN_FIELD)
+}
+SMBUS_GEN_SNAPSHOT;
+
+static inline const smbus_device_desc_t* SMBUS_GEN_SYM(_desc)(void)
+{
+    typedef SMBUS_GEN_SNAPSHOT smbus_gen_snapshot_t;
+
+    static const smbus_reg_desc_t regs[] = {
+        SMBUS_DEVICE_REGS(SMBUS_GEN_DESC)
+    };
+    static const smbus_device_desc_t desc = {
+        .name = SMBUS_GEN_STR(SMBUS_DEVICE_NAME),
+        .regs = regs,
+        .reg_count = sizeof(regs) / sizeof(regs[0]),
+    };
+
+    return &desc;
+}
+
+SMBUS_DEVICE_REGS(SMBUS_GEN_FUNCS)
+
+
+#undef SMBUS_GEN_CAT_
+#undef SMBUS_GEN_CAT
+#undef SMBUS_GEN_STR_
+#undef SMBUS_GEN_STR
+#undef SMBUS_GEN_SYM
+#undef SMBUS_GEN_SNAPSHOT
+#undef SMBUS_GEN_FIELD_RO
+#undef SMBUS_GEN_FIELD_WO
+#undef SMBUS_GEN_FIELD_RW
+#undef SMBUS_GEN_FIELD
+#undef SMBUS_GEN_DESC_RO
+#undef SMBUS_GEN_DESC_WO
+#undef SMBUS_GEN_DESC_RW
+#undef SMBUS_GEN_DESC
+#undef SMBUS_GEN_READER
+#undef SMBUS_GEN_WRITER
+#undef SMBUS_GEN_ACCESSORS_RO
+#undef SMBUS_GEN_ACCESSORS_WO
+#undef SMBUS_GEN_ACCESSORS_RW
+#undef SMBUS_GEN_SCALED_NUM
+#undef SMBUS_GEN_SCALED_BYTE
+#undef SMBUS_GEN_SCALED_WORD
+#undef SMBUS_GEN_SCALED_DWORD
+#undef SMBUS_GEN_SCALED_QWORD
+#undef SMBUS_GEN_SCALED_BLOCK
+#undef SMBUS_GEN_SCALED_RO
+#undef SMBUS_GEN_SCALED_WO
+#undef SMBUS_GEN_SCALED_RW
+#undef SMBUS_GEN_FUNCS
+#undef SMBUS_DEVICE_NAME
+#undef SMBUS_DEVICE_REGS
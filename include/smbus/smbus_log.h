@@ -0,0 +1,111 @@
+#ifndef SMBUS_LOG_H
+#define SMBUS_LOG_H
+
+#include <smbus/smbus.h>
+#include <smbus/smbus_device.h>
+#include <stddef.h>
+
+// Columnar append-only sample log. The file is a sequence of fixed size
+// blocks, each holding either series descriptors or the samples of a single
+// series: the first sample verbatim in the block header, then per sample the
+// zigzag varint of the timestamp delta-of-delta followed by the zigzag varint
+// of the value delta. Regularly sampled, slowly changing registers cost two
+// bytes per sample. Blocks are stored in host byte order.
+
+#define SMBUS_LOG_BLOCK_SIZE 4096
+#define SMBUS_LOG_SERIES_MAX 256
+#define SMBUS_LOG_NAME_MAX 24
+
+
+typedef void* smbus_log_handle_t;
+typedef void* smbus_log_reader_t;
+
+typedef struct smbus_log_series_t
+{
+    uint16_t id;
+    uint8_t address;
+    uint8_t command;
+    // smbus_reg_type_t, BLOCK registers cannot be logged
+    uint8_t type;
+    uint8_t reserved[3];
+    char name[SMBUS_LOG_NAME_MAX];
+}
+smbus_log_series_t;
+
+typedef struct smbus_log_sample_t
+{
+    uint16_t series;
+    uint64_t timestamp_ns;
+    uint64_t value;
+}
+smbus_log_sample_t;
+
+typedef struct smbus_log_stats_t
+{
+    uint64_t samples;
+    uint64_t blocks;
+    // Encoded sample bytes, excluding block headers and padding
+    uint64_t payload_bytes;
+    uint64_t bytes_written;
+    // Time spent writing blocks to the file
+    uint64_t write_ns;
+}
+smbus_log_stats_t;
+
+
+// Creates (or truncates) the log file, written with O_DIRECT when the filesystem supports it
+smbus_log_handle_t smbus_log_open(
+    const char* path
+);
+// Flushes partially filled blocks and closes the file
+bool smbus_log_close(
+    smbus_log_handle_t log_handle
+);
+// Returns the new series id, or -1 on error
+int smbus_log_add_series(
+    smbus_log_handle_t log_handle,
+    const char* name,
+    uint8_t address,
+    uint8_t command,
+    smbus_reg_type_t type
+);
+bool smbus_log_append(
+    smbus_log_handle_t log_handle,
+    uint16_t series,
+    uint64_t timestamp_ns,
+    uint64_t value
+);
+// Reads the series register (switching the slave address if needed) and appends it with a CLOCK_REALTIME timestamp
+bool smbus_log_sample(
+    smbus_log_handle_t log_handle,
+    uint16_t series,
+    smbus_handle_t smbus_handle
+);
+// Writes out partially filled blocks, following samples start new blocks
+bool smbus_log_flush(
+    smbus_log_handle_t log_handle
+);
+bool smbus_log_get_stats(
+    smbus_log_handle_t log_handle,
+    smbus_log_stats_t* stats
+);
+
+smbus_log_reader_t smbus_log_reader_open(
+    const char* path
+);
+bool smbus_log_reader_close(
+    smbus_log_reader_t log_reader
+);
+// Samples come block by block, ordered by time within each series only.
+// Returns false with errno 0 at the end of the log.
+bool smbus_log_reader_next(
+    smbus_log_reader_t log_reader,
+    smbus_log_sample_t* sample
+);
+// Descriptor of a series seen so far, NULL if unknown
+const smbus_log_series_t* smbus_log_reader_series(
+    smbus_log_reader_t log_reader,
+    uint16_t series
+);
+
+#endif // SMBUS_LOG_H
@@ -0,0 +1,237 @@
+#ifndef SMBUS_INST_H
+#define SMBUS_INST_H
+
+#include <smbus/smbus.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+#define SMBUS_HANDLE_CHECK(smbus_handle)    \
+    {                                       \
+        if(smbus_handle == NULL)            \
+        {                                   \
+            errno = EINVAL;                 \
+            return false;                   \
+        }                                   \
+    }                                       \
+    while(0)
+
+// Command byte + byte count + block + PEC
+#define SMBUS_EMUL_WRITE_MAX (SMBUS_BLOCK_MAX + 3)
+// Byte count + block + PEC
+#define SMBUS_EMUL_READ_MAX (SMBUS_BLOCK_MAX + 2)
+
+typedef struct smbus_wire_t
+{
+    uint32_t clock_hz;
+    uint64_t transfers;
+    uint64_t wire_bits;
+    uint64_t wire_ns;
+    uint64_t busy_ns;
+    // Start of the accounting period
+    uint64_t start_ns;
+}
+smbus_wire_t;
+
+typedef struct smbus_flight_t smbus_flight_t;
+typedef struct smbus_rt_t smbus_rt_t;
+typedef struct smbus_rp1_t smbus_rp1_t;
+typedef struct smbus_device_plan_t smbus_device_plan_t;
+
+typedef struct smbus_inst_t
+{
+    int i2c_bus;
+    unsigned bus_index;
+    unsigned long func_flags;
+    // Functionality reported by the adapter, func_flags may be masked below it
+    unsigned long adapter_funcs;
+    pthread_mutex_t lock;
+    unsigned lock_depth;
+    // Nesting of smbus_inst_lock in the owning thread
+    unsigned hold_depth;
+    // Bumped by smbus_cancel, work queued on the lock before that is dropped
+    atomic_uint cancel_generation;
+    unsigned hold_generation;
+    // Adapter timeout set from a thread deadline in 10 ms units, 0 while at the default
+    unsigned long timeout_units;
+    smbus_flight_t* flight;
+    // Plans of smbus_device_read_all/_volatile, one per descriptor and selection
+    smbus_device_plan_t* device_plans;
+    smbus_rt_t* rt;
+    // Userspace RP1 controller backend, NULL for i2c-dev
+    smbus_rp1_t* rp1;
+    // Bus occupancy accounting, updated under the handle lock
+    smbus_wire_t wire;
+    // Adapter refuses I2C_RDWR submissions mixing addresses, like i2c-designware
+    bool is_rdwr_split;
+    // Adapter refuses I2C_M_RECV_LEN, block reads take a fixed length instead
+    bool is_recv_len_refused;
+    // Handles of the bus manager are released instead of closed
+    bool is_managed;
+    unsigned manager_refs;
+    uint8_t is_pec_enabled : 1;
+    uint8_t slave_address : 7;
+}
+smbus_inst_t;
+
+typedef struct smbus_emul_t
+{
+    unsigned command_type;
+    uint8_t read_write;
+    uint8_t is_pec_enabled;
+    struct i2c_msg msgs[2];
+    unsigned msg_count;
+    uint8_t write_buf[SMBUS_EMUL_WRITE_MAX];
+    uint8_t read_buf[SMBUS_EMUL_READ_MAX];
+}
+smbus_emul_t;
+
+// Serialises handle users within the process, recursive
+void smbus_inst_lock(
+    smbus_inst_t* smbus_inst
+);
+void smbus_inst_unlock(
+    smbus_inst_t* smbus_inst
+);
+
+smbus_inst_t* smbus_inst_create(
+    int i2c_bus,
+    unsigned bus_index
+);
+bool smbus_inst_destroy(
+    smbus_inst_t* smbus_inst
+);
+
+// Bus transfer ioctls, executed by the real-time worker when it is running
+int smbus_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+);
+int smbus_rt_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+);
+// i2c-dev ioctl, or its equivalent on the RP1 backend
+int smbus_backend_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+);
+int smbus_rp1_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+);
+void smbus_rp1_destroy(
+    smbus_inst_t* smbus_inst
+);
+
+void smbus_wire_init(
+    smbus_wire_t* wire
+);
+uint64_t smbus_wire_now(void);
+// Adds the wire cost of a finished I2C_SMBUS or I2C_RDWR transfer
+void smbus_wire_account(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg,
+    int res,
+    uint64_t start_ns
+);
+
+// Drops a transfer which was cancelled or is already late, else fits the adapter timeout to the deadline
+int smbus_deadline_check(
+    smbus_inst_t* smbus_inst
+);
+// errno of a failed transfer, ETIME when the deadline ran out meanwhile
+int smbus_deadline_error(
+    smbus_inst_t* smbus_inst,
+    int error
+);
+// Puts the adapter timeout back to the kernel default if a deadline changed it
+void smbus_deadline_restore(
+    smbus_inst_t* smbus_inst
+);
+
+// Raw transfer, native SMBus ioctl or I2C_RDWR emulation
+int smbus_bus_access(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t read_write,
+    uint8_t command,
+    union i2c_smbus_data* data
+);
+
+int smbus_flight_access(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t read_write,
+    uint8_t command,
+    union i2c_smbus_data* data
+);
+void smbus_flight_destroy(
+    smbus_inst_t* smbus_inst
+);
+// Marks cached reads of every device a finished transfer may have changed as stale
+void smbus_flight_written(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+);
+
+void smbus_device_plans_destroy(
+    smbus_inst_t* smbus_inst
+);
+
+uint8_t smbus_calc_i2c_read_block_pec(
+    uint8_t slave_address,
+    uint8_t command,
+    uint8_t* block 
+);
+
+bool smbus_is_native(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t read_write
+);
+
+int smbus_emul_prepare(
+    smbus_emul_t* emul,
+    uint8_t slave_address,
+    bool is_pec_enabled,
+    unsigned command_type,
+    uint8_t read_write,
+    uint8_t command,
+    union i2c_smbus_data* data
+);
+int smbus_emul_complete(
+    smbus_inst_t* smbus_inst,
+    smbus_emul_t* emul,
+    union i2c_smbus_data* data
+);
+int smbus_emul_batch(
+    smbus_inst_t* smbus_inst,
+    smbus_emul_t* emuls,
+    size_t emul_count
+);
+// I2C_RDWR submission, split into runs of one address where the adapter refuses mixed
+// ones. done_count, if given, receives the messages known to be complete.
+int smbus_rdwr_submit(
+    smbus_inst_t* smbus_inst,
+    struct i2c_msg* msgs,
+    unsigned msg_count,
+    unsigned* done_count
+);
+int smbus_emul_access(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t read_write,
+    uint8_t command,
+    union i2c_smbus_data* data
+);
+
+#endif // SMBUS_INST_H
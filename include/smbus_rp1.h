@@ -0,0 +1,121 @@
+#ifndef SMBUS_RP1_H
+#define SMBUS_RP1_H
+
+#include <smbus_inst.h>
+
+// DesignWare APB I2C registers of the RP1 controllers
+#define SMBUS_RP1_IC_CON                0x00
+#define SMBUS_RP1_IC_TAR                0x04
+#define SMBUS_RP1_IC_DATA_CMD           0x10
+#define SMBUS_RP1_IC_INTR_MASK          0x30
+#define SMBUS_RP1_IC_RAW_INTR_STAT      0x34
+#define SMBUS_RP1_IC_CLR_INTR           0x40
+#define SMBUS_RP1_IC_CLR_TX_ABRT        0x54
+#define SMBUS_RP1_IC_CLR_STOP_DET       0x60
+#define SMBUS_RP1_IC_ENABLE             0x6C
+#define SMBUS_RP1_IC_STATUS             0x70
+#define SMBUS_RP1_IC_TXFLR              0x74
+#define SMBUS_RP1_IC_RXFLR              0x78
+#define SMBUS_RP1_IC_TX_ABRT_SOURCE     0x80
+#define SMBUS_RP1_IC_ENABLE_STATUS      0x9C
+#define SMBUS_RP1_IC_COMP_PARAM_1       0xF4
+#define SMBUS_RP1_IC_COMP_TYPE          0xFC
+
+#define SMBUS_RP1_REG_SIZE              0x100
+
+#define SMBUS_RP1_CON_MASTER            0x0001
+#define SMBUS_RP1_CON_SPEED_MASK        0x0006
+#define SMBUS_RP1_CON_SPEED_STD         0x0002
+#define SMBUS_RP1_CON_RESTART_EN        0x0020
+#define SMBUS_RP1_CON_SLAVE_DISABLE     0x0040
+
+#define SMBUS_RP1_DATA_CMD_READ         0x0100
+#define SMBUS_RP1_DATA_CMD_STOP         0x0200
+#define SMBUS_RP1_DATA_CMD_RESTART      0x0400
+
+#define SMBUS_RP1_STATUS_ACTIVITY       0x0001
+#define SMBUS_RP1_STATUS_TFNF           0x0002
+#define SMBUS_RP1_STATUS_TFE            0x0004
+#define SMBUS_RP1_STATUS_RFNE           0x0008
+
+#define SMBUS_RP1_INTR_TX_ABRT          0x0040
+#define SMBUS_RP1_INTR_STOP_DET         0x0200
+
+#define SMBUS_RP1_ABRT_7B_ADDR_NOACK    0x0001
+#define SMBUS_RP1_ABRT_TXDATA_NOACK     0x0008
+
+#define SMBUS_RP1_COMP_TYPE_DW          0x44570140
+#define SMBUS_RP1_TX_DEPTH(param)       ((((param) >> 16) & 0xFF) + 1)
+#define SMBUS_RP1_RX_DEPTH(param)       ((((param) >> 8) & 0xFF) + 1)
+
+typedef struct smbus_rp1_emul_t smbus_rp1_emul_t;
+
+struct smbus_rp1_t
+{
+    volatile uint32_t* regs;
+    void* map;
+    size_t map_len;
+    unsigned tx_depth;
+    unsigned rx_depth;
+    // IC_TAR can only change while the controller is disabled
+    uint16_t target;
+    bool is_target_set;
+    unsigned timeout_ms;
+    // Register-level controller model, NULL on hardware
+    smbus_rp1_emul_t* emul;
+};
+
+uint32_t smbus_rp1_emul_read(
+    smbus_rp1_emul_t* emul,
+    unsigned reg
+);
+void smbus_rp1_emul_write(
+    smbus_rp1_emul_t* emul,
+    unsigned reg,
+    uint32_t value
+);
+
+static inline uint32_t smbus_rp1_read(
+    smbus_rp1_t* rp1,
+    unsigned reg
+)
+{
+    if(rp1->emul != NULL)
+    {
+        return smbus_rp1_emul_read(rp1->emul, reg);
+    }
+
+    return rp1->regs[reg / sizeof(uint32_t)];
+}
+
+static inline void smbus_rp1_write(
+    smbus_rp1_t* rp1,
+    unsigned reg,
+    uint32_t value
+)
+{
+    if(rp1->emul != NULL)
+    {
+        smbus_rp1_emul_write(rp1->emul, reg, value);
+        return;
+    }
+
+    rp1->regs[reg / sizeof(uint32_t)] = value;
+}
+
+// Maps the register block and brings the controller up in polled master mode
+smbus_rp1_t* smbus_rp1_create(
+    int fd,
+    uint64_t offset,
+    size_t map_len,
+    bool is_emulated
+);
+
+// Size of the emulator file: register block, controller state and target memories
+size_t smbus_rp1_emul_size(void);
+// Sets reset values on a blank emulator file, an existing one keeps its state
+void smbus_rp1_emul_init(
+    smbus_rp1_emul_t* emul
+);
+
+#endif // SMBUS_RP1_H
@@ -0,0 +1,43 @@
+#ifndef SMBUS_TRACE_H
+#define SMBUS_TRACE_H
+
+// USDT probes of the "smbus" provider, compiled to a single nop each when
+// SMBUS_USDT is defined and expanded to nothing otherwise. Arguments are cast
+// to plain integers since sys/sdt.h cannot take bit-fields.
+//
+//   transaction_start (bus, address, command, size, read_write)
+//   transaction_end   (bus, address, command, size, result)
+//   batch_start       (bus, msg_count)
+//   batch_end         (bus, msg_count, result)
+//   pec_mismatch      (bus, address, command, received_pec, calculated_pec)
+//   slave_switch      (bus, old_address, new_address)
+
+#ifdef SMBUS_USDT
+
+#include <sys/sdt.h>
+
+#define SMBUS_TRACE_TRANSACTION_START(bus, address, command, size, read_write) \
+    STAP_PROBE5(smbus, transaction_start, (unsigned)(bus), (unsigned)(address), (unsigned)(command), (unsigned)(size), (unsigned)(read_write))
+#define SMBUS_TRACE_TRANSACTION_END(bus, address, command, size, result) \
+    STAP_PROBE5(smbus, transaction_end, (unsigned)(bus), (unsigned)(address), (unsigned)(command), (unsigned)(size), (int)(result))
+#define SMBUS_TRACE_BATCH_START(bus, msg_count) \
+    STAP_PROBE2(smbus, batch_start, (unsigned)(bus), (unsigned)(msg_count))
+#define SMBUS_TRACE_BATCH_END(bus, msg_count, result) \
+    STAP_PROBE3(smbus, batch_end, (unsigned)(bus), (unsigned)(msg_count), (int)(result))
+#define SMBUS_TRACE_PEC_MISMATCH(bus, address, command, received_pec, calculated_pec) \
+    STAP_PROBE5(smbus, pec_mismatch, (unsigned)(bus), (unsigned)(address), (unsigned)(command), (unsigned)(received_pec), (unsigned)(calculated_pec))
+#define SMBUS_TRACE_SLAVE_SWITCH(bus, old_address, new_address) \
+    STAP_PROBE3(smbus, slave_switch, (unsigned)(bus), (unsigned)(old_address), (unsigned)(new_address))
+
+#else
+
+#define SMBUS_TRACE_TRANSACTION_START(bus, address, command, size, read_write)
+#define SMBUS_TRACE_TRANSACTION_END(bus, address, command, size, result)
+#define SMBUS_TRACE_BATCH_START(bus, msg_count)
+#define SMBUS_TRACE_BATCH_END(bus, msg_count, result)
+#define SMBUS_TRACE_PEC_MISMATCH(bus, address, command, received_pec, calculated_pec)
+#define SMBUS_TRACE_SLAVE_SWITCH(bus, old_address, new_address)
+
+#endif // SMBUS_USDT
+
+#endif // SMBUS_TRACE_H
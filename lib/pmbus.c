@@ -0,0 +1,374 @@
+#include <smbus/pmbus.h>
+#include <stdlib.h>
+#include <errno.h>
+
+#define PMBUS_HANDLE_CHECK(pmbus_handle)    \
+    {                                       \
+        if(pmbus_handle == NULL)            \
+        {                                   \
+            errno = EINVAL;                 \
+            return false;                   \
+        }                                   \
+    }                                       \
+    while(0)
+
+#define PMBUS_VOUT_MODE_TYPE(vout_mode) ((vout_mode) >> 5)
+
+typedef struct pmbus_inst_t
+{
+    smbus_handle_t smbus_handle;
+    uint8_t address;
+    uint8_t page;
+    bool is_page_known;
+    uint32_t vout_mode_valid;
+    uint8_t vout_mode[PMBUS_PAGE_MAX + 1];
+}
+pmbus_inst_t;
+
+static bool pmbus_select(
+    pmbus_inst_t* pmbus_inst,
+    uint8_t page
+);
+
+static bool pmbus_begin(
+    pmbus_inst_t* pmbus_inst,
+    uint8_t page
+);
+
+static bool pmbus_end(
+    pmbus_inst_t* pmbus_inst,
+    bool res
+);
+
+pmbus_handle_t pmbus_open(
+    smbus_handle_t smbus_handle,
+    uint8_t address
+)
+{
+    pmbus_inst_t* pmbus_inst = NULL;
+
+    if(smbus_handle == NULL)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    pmbus_inst = calloc(1, sizeof(pmbus_inst_t));
+
+    if(pmbus_inst != NULL)
+    {
+        pmbus_inst->smbus_handle = smbus_handle;
+        pmbus_inst->address = address;
+    }
+
+    return pmbus_inst;
+}
+
+bool pmbus_close(
+    pmbus_handle_t pmbus_handle
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+
+    free(pmbus_handle);
+
+    return true;
+}
+
+bool pmbus_invalidate(
+    pmbus_handle_t pmbus_handle
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+
+    pmbus_inst->is_page_known = false;
+    pmbus_inst->vout_mode_valid = 0;
+
+    return true;
+}
+
+bool pmbus_select(
+    pmbus_inst_t* pmbus_inst,
+    uint8_t page
+)
+{
+    if(smbus_get_slave(pmbus_inst->smbus_handle) != pmbus_inst->address &&
+        !smbus_use_slave(pmbus_inst->smbus_handle, pmbus_inst->address))
+    {
+        return false;
+    }
+
+    if(page == PMBUS_PAGE_NONE || (pmbus_inst->is_page_known && pmbus_inst->page == page))
+    {
+        return true;
+    }
+
+    if(!smbus_write_byte_data(pmbus_inst->smbus_handle, PMBUS_PAGE, page))
+    {
+        pmbus_inst->is_page_known = false;
+        return false;
+    }
+
+    pmbus_inst->page = page;
+    pmbus_inst->is_page_known = true;
+
+    return true;
+}
+
+bool pmbus_begin(
+    pmbus_inst_t* pmbus_inst,
+    uint8_t page
+)
+{
+    // Slave address and PAGE must hold until the command went out, other users may share the handle
+    if(!smbus_lock(pmbus_inst->smbus_handle))
+    {
+        return false;
+    }
+
+    if(!pmbus_select(pmbus_inst, page))
+    {
+        return pmbus_end(pmbus_inst, false);
+    }
+
+    return true;
+}
+
+bool pmbus_end(
+    pmbus_inst_t* pmbus_inst,
+    bool res
+)
+{
+    int error = errno;
+
+    // A failed transfer leaves the device PAGE unknown, e.g. after a reset
+    if(!res)
+    {
+        pmbus_inst->is_page_known = false;
+    }
+
+    smbus_unlock(pmbus_inst->smbus_handle);
+
+    errno = error;
+
+    return res;
+}
+
+bool pmbus_set_page(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+
+    if(!pmbus_begin(pmbus_inst, page))
+    {
+        return false;
+    }
+
+    return pmbus_end(pmbus_inst, true);
+}
+
+bool pmbus_get_vout_mode(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t* vout_mode
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+
+    // Non-paged devices share the page 0 slot
+    uint8_t slot = (page == PMBUS_PAGE_NONE) ? 0 : page;
+    bool is_cacheable = (slot <= PMBUS_PAGE_MAX);
+
+    // The cache is shared by the users of the handle as well
+    if(!smbus_lock(pmbus_inst->smbus_handle))
+    {
+        return false;
+    }
+
+    if(is_cacheable && (pmbus_inst->vout_mode_valid & (1UL << slot)))
+    {
+        *vout_mode = pmbus_inst->vout_mode[slot];
+        return pmbus_end(pmbus_inst, true);
+    }
+
+    if(!pmbus_read_byte(pmbus_handle, page, PMBUS_VOUT_MODE, vout_mode))
+    {
+        return pmbus_end(pmbus_inst, false);
+    }
+
+    if(is_cacheable)
+    {
+        pmbus_inst->vout_mode[slot] = *vout_mode;
+        pmbus_inst->vout_mode_valid |= (1UL << slot);
+    }
+
+    return pmbus_end(pmbus_inst, true);
+}
+
+bool pmbus_read_byte(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint8_t* byte
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+
+    if(!pmbus_begin(pmbus_inst, page))
+    {
+        return false;
+    }
+
+    return pmbus_end(pmbus_inst, smbus_read_byte_data(pmbus_inst->smbus_handle, command, byte));
+}
+
+bool pmbus_write_byte(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint8_t byte
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+
+    if(command == PMBUS_PAGE)
+    {
+        return pmbus_set_page(pmbus_handle, byte);
+    }
+
+    if(!pmbus_begin(pmbus_inst, page))
+    {
+        return false;
+    }
+
+    if(command == PMBUS_VOUT_MODE)
+    {
+        pmbus_inst->vout_mode_valid = 0;
+    }
+
+    return pmbus_end(pmbus_inst, smbus_write_byte_data(pmbus_inst->smbus_handle, command, byte));
+}
+
+bool pmbus_read_word(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint16_t* word
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+
+    if(!pmbus_begin(pmbus_inst, page))
+    {
+        return false;
+    }
+
+    return pmbus_end(pmbus_inst, smbus_read_word_data(pmbus_inst->smbus_handle, command, word));
+}
+
+bool pmbus_write_word(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    uint16_t word
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+
+    if(!pmbus_begin(pmbus_inst, page))
+    {
+        return false;
+    }
+
+    return pmbus_end(pmbus_inst, smbus_write_word_data(pmbus_inst->smbus_handle, command, word));
+}
+
+bool pmbus_read_linear11(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    float* value
+)
+{
+    uint16_t raw = 0;
+
+    if(!pmbus_read_word(pmbus_handle, page, command, &raw))
+    {
+        return false;
+    }
+
+    *value = pmbus_linear11_to_float(raw);
+
+    return true;
+}
+
+bool pmbus_read_direct(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    uint8_t command,
+    const pmbus_direct_t* coefficients,
+    float* value
+)
+{
+    uint16_t raw = 0;
+
+    if(!pmbus_read_word(pmbus_handle, page, command, &raw))
+    {
+        return false;
+    }
+
+    *value = pmbus_direct_to_float(raw, coefficients);
+
+    return true;
+}
+
+bool pmbus_read_vout(
+    pmbus_handle_t pmbus_handle,
+    uint8_t page,
+    float* value
+)
+{
+    PMBUS_HANDLE_CHECK(pmbus_handle);
+    pmbus_inst_t* pmbus_inst = (pmbus_inst_t*)pmbus_handle;
+    uint8_t vout_mode = 0;
+    uint16_t raw = 0;
+
+    // VOUT_MODE and READ_VOUT of the same page, with no VOUT_MODE write in between
+    if(!smbus_lock(pmbus_inst->smbus_handle))
+    {
+        return false;
+    }
+
+    if(!pmbus_get_vout_mode(pmbus_handle, page, &vout_mode))
+    {
+        return pmbus_end(pmbus_inst, false);
+    }
+
+    if(PMBUS_VOUT_MODE_TYPE(vout_mode) != PMBUS_VOUT_MODE_LINEAR)
+    {
+        smbus_unlock(pmbus_inst->smbus_handle);
+
+        errno = ENOTSUP;
+        return false;
+    }
+
+    if(!pmbus_read_word(pmbus_handle, page, PMBUS_READ_VOUT, &raw))
+    {
+        return pmbus_end(pmbus_inst, false);
+    }
+
+    pmbus_end(pmbus_inst, true);
+
+    *value = pmbus_linear16_to_float(raw, vout_mode);
+
+    return true;
+}
@@ -0,0 +1,243 @@
+#include <smbus/pmbus.h>
+#include <string.h>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define PMBUS_DECODE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define PMBUS_DECODE_SSE2
+#endif
+
+// Words decoded per vector iteration
+#define PMBUS_DECODE_LANES 8
+
+static float pmbus_exp2(
+    int exponent
+);
+
+static void pmbus_direct_factors(
+    const pmbus_direct_t* coefficients,
+    float* scale,
+    float* offset
+);
+
+float pmbus_exp2(
+    int exponent
+)
+{
+    // PMBus exponents are within [-16, 15], always a normal float
+    uint32_t bits = (uint32_t)(exponent + 127) << 23;
+    float value = 0;
+
+    memcpy(&value, &bits, sizeof(float));
+
+    return value;
+}
+
+void pmbus_direct_factors(
+    const pmbus_direct_t* coefficients,
+    float* scale,
+    float* offset
+)
+{
+    // X = (Y * 10^-R - b) / m
+    float power = 1.0f;
+
+    for(int8_t r = coefficients->r; r > 0; --r)
+    {
+        power /= 10.0f;
+    }
+
+    for(int8_t r = coefficients->r; r < 0; ++r)
+    {
+        power *= 10.0f;
+    }
+
+    *scale = power / coefficients->m;
+    *offset = -(float)coefficients->b / coefficients->m;
+}
+
+float pmbus_linear11_to_float(
+    uint16_t raw
+)
+{
+    int16_t exponent = (int16_t)raw >> 11;
+    int16_t mantissa = (int16_t)(raw << 5) >> 5;
+
+    return mantissa * pmbus_exp2(exponent);
+}
+
+float pmbus_linear16_to_float(
+    uint16_t raw,
+    uint8_t vout_mode
+)
+{
+    int8_t exponent = (int8_t)(vout_mode << 3) >> 3;
+
+    return raw * pmbus_exp2(exponent);
+}
+
+float pmbus_direct_to_float(
+    uint16_t raw,
+    const pmbus_direct_t* coefficients
+)
+{
+    float scale = 0;
+    float offset = 0;
+
+    pmbus_direct_factors(coefficients, &scale, &offset);
+
+    return (int16_t)raw * scale + offset;
+}
+
+void pmbus_decode_linear11(
+    const uint16_t* raw,
+    float* values,
+    size_t count
+)
+{
+    size_t i = 0;
+
+#if defined(PMBUS_DECODE_NEON)
+    const int32x4_t bias = vdupq_n_s32(127);
+
+    for(; i + PMBUS_DECODE_LANES <= count; i += PMBUS_DECODE_LANES)
+    {
+        int16x8_t words = vreinterpretq_s16_u16(vld1q_u16(&raw[i]));
+        int16x8_t mantissa = vshrq_n_s16(vshlq_n_s16(words, 5), 5);
+        int16x8_t exponent = vshrq_n_s16(words, 11);
+
+        int32x4_t exponent_lo = vshlq_n_s32(vaddq_s32(vmovl_s16(vget_low_s16(exponent)), bias), 23);
+        int32x4_t exponent_hi = vshlq_n_s32(vaddq_s32(vmovl_s16(vget_high_s16(exponent)), bias), 23);
+
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(mantissa)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(mantissa)));
+
+        vst1q_f32(&values[i], vmulq_f32(lo, vreinterpretq_f32_s32(exponent_lo)));
+        vst1q_f32(&values[i + 4], vmulq_f32(hi, vreinterpretq_f32_s32(exponent_hi)));
+    }
+#elif defined(PMBUS_DECODE_SSE2)
+    const __m128i bias = _mm_set1_epi32(127);
+
+    for(; i + PMBUS_DECODE_LANES <= count; i += PMBUS_DECODE_LANES)
+    {
+        __m128i words = _mm_loadu_si128((const __m128i*)&raw[i]);
+        __m128i mantissa = _mm_srai_epi16(_mm_slli_epi16(words, 5), 5);
+        __m128i exponent = _mm_srai_epi16(words, 11);
+
+        // Interleave with itself and shift back to sign extend 16 -> 32 bits
+        __m128i mantissa_lo = _mm_srai_epi32(_mm_unpacklo_epi16(mantissa, mantissa), 16);
+        __m128i mantissa_hi = _mm_srai_epi32(_mm_unpackhi_epi16(mantissa, mantissa), 16);
+        __m128i exponent_lo = _mm_srai_epi32(_mm_unpacklo_epi16(exponent, exponent), 16);
+        __m128i exponent_hi = _mm_srai_epi32(_mm_unpackhi_epi16(exponent, exponent), 16);
+
+        __m128 power_lo = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent_lo, bias), 23));
+        __m128 power_hi = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(exponent_hi, bias), 23));
+
+        _mm_storeu_ps(&values[i], _mm_mul_ps(_mm_cvtepi32_ps(mantissa_lo), power_lo));
+        _mm_storeu_ps(&values[i + 4], _mm_mul_ps(_mm_cvtepi32_ps(mantissa_hi), power_hi));
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        values[i] = pmbus_linear11_to_float(raw[i]);
+    }
+}
+
+void pmbus_decode_linear16(
+    const uint16_t* raw,
+    float* values,
+    size_t count,
+    uint8_t vout_mode
+)
+{
+    size_t i = 0;
+    int8_t exponent = (int8_t)(vout_mode << 3) >> 3;
+    float power = pmbus_exp2(exponent);
+
+#if defined(PMBUS_DECODE_NEON)
+    const float32x4_t factor = vdupq_n_f32(power);
+
+    for(; i + PMBUS_DECODE_LANES <= count; i += PMBUS_DECODE_LANES)
+    {
+        uint16x8_t words = vld1q_u16(&raw[i]);
+
+        float32x4_t lo = vcvtq_f32_u32(vmovl_u16(vget_low_u16(words)));
+        float32x4_t hi = vcvtq_f32_u32(vmovl_u16(vget_high_u16(words)));
+
+        vst1q_f32(&values[i], vmulq_f32(lo, factor));
+        vst1q_f32(&values[i + 4], vmulq_f32(hi, factor));
+    }
+#elif defined(PMBUS_DECODE_SSE2)
+    const __m128 factor = _mm_set1_ps(power);
+    const __m128i zero = _mm_setzero_si128();
+
+    for(; i + PMBUS_DECODE_LANES <= count; i += PMBUS_DECODE_LANES)
+    {
+        __m128i words = _mm_loadu_si128((const __m128i*)&raw[i]);
+
+        // Zero extended words always fit a signed 32-bit conversion
+        __m128 lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, zero));
+        __m128 hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, zero));
+
+        _mm_storeu_ps(&values[i], _mm_mul_ps(lo, factor));
+        _mm_storeu_ps(&values[i + 4], _mm_mul_ps(hi, factor));
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        values[i] = raw[i] * power;
+    }
+}
+
+void pmbus_decode_direct(
+    const uint16_t* raw,
+    float* values,
+    size_t count,
+    const pmbus_direct_t* coefficients
+)
+{
+    size_t i = 0;
+    float scale = 0;
+    float offset = 0;
+
+    pmbus_direct_factors(coefficients, &scale, &offset);
+
+#if defined(PMBUS_DECODE_NEON)
+    const float32x4_t scale_vec = vdupq_n_f32(scale);
+    const float32x4_t offset_vec = vdupq_n_f32(offset);
+
+    for(; i + PMBUS_DECODE_LANES <= count; i += PMBUS_DECODE_LANES)
+    {
+        int16x8_t words = vreinterpretq_s16_u16(vld1q_u16(&raw[i]));
+
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(words)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(words)));
+
+        vst1q_f32(&values[i], vmlaq_f32(offset_vec, lo, scale_vec));
+        vst1q_f32(&values[i + 4], vmlaq_f32(offset_vec, hi, scale_vec));
+    }
+#elif defined(PMBUS_DECODE_SSE2)
+    const __m128 scale_vec = _mm_set1_ps(scale);
+    const __m128 offset_vec = _mm_set1_ps(offset);
+
+    for(; i + PMBUS_DECODE_LANES <= count; i += PMBUS_DECODE_LANES)
+    {
+        __m128i words = _mm_loadu_si128((const __m128i*)&raw[i]);
+
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(words, words), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(words, words), 16));
+
+        _mm_storeu_ps(&values[i], _mm_add_ps(_mm_mul_ps(lo, scale_vec), offset_vec));
+        _mm_storeu_ps(&values[i + 4], _mm_add_ps(_mm_mul_ps(hi, scale_vec), offset_vec));
+    }
+#endif
+
+    for(; i < count; ++i)
+    {
+        values[i] = (int16_t)raw[i] * scale + offset;
+    }
+}
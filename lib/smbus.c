@@ -1,5 +1,7 @@
 #include <smbus/smbus.h>
+#include <smbus_inst.h>
 #include <smbus_pec.h>
+#include <smbus_trace.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -7,44 +9,19 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/ioctl.h>
-#include <linux/i2c.h>
-#include <linux/i2c-dev.h>
+#include <sys/file.h>
 
 #define SMBUS_I2C_DEVICE_FORMAT "/dev/i2c-%u"
 #define SMBUS_I2C_DEVICE_NAME_LEN 20
 
-#define SMBUS_HANDLE_CHECK(smbus_handle)    \
-    {                                       \
-        if(smbus_handle == NULL)            \
-        {                                   \
-            errno = EINVAL;                 \
-            return false;                   \
-        }                                   \
-    }                                       \
-    while(0)
-
-typedef struct smbus_inst_t
-{
-    int i2c_bus;
-    uint8_t is_pec_enabled : 1;
-    uint8_t slave_address : 7;
-}
-smbus_inst_t;
-
 static int smbus_rw_access(
-    uint8_t i2c_bus,
+    smbus_inst_t* smbus_inst,
     unsigned command_type, 
     uint8_t read_write, 
     uint8_t reg,
     union i2c_smbus_data* data
 );
 
-static uint8_t smbus_calc_i2c_read_block_pec(
-    uint8_t slave_address,
-    uint8_t command,
-    uint8_t* block 
-);
-
 static uint8_t smbus_calc_i2c_write_block_pec(
     uint8_t slave_address,
     uint8_t command,
@@ -64,10 +41,49 @@ smbus_handle_t smbus_open(
 
     if(i2c_bus >= 0)
     {
-        smbus_inst = calloc(1, sizeof(smbus_inst_t));
-        smbus_inst->i2c_bus = i2c_bus;
+        smbus_inst = smbus_inst_create(i2c_bus, bus_index);
+
+        if(smbus_inst == NULL)
+        {
+            close(i2c_bus);
+            return NULL;
+        }
+
+        if(ioctl(i2c_bus, I2C_FUNCS, &smbus_inst->func_flags) < 0)
+        {
+            smbus_inst->func_flags = 0;
+        }
+
+        smbus_inst->adapter_funcs = smbus_inst->func_flags;
+    }
+
+    return smbus_inst;
+}
+
+smbus_inst_t* smbus_inst_create(
+    int i2c_bus,
+    unsigned bus_index
+)
+{
+    smbus_inst_t* smbus_inst = calloc(1, sizeof(smbus_inst_t));
+
+    if(smbus_inst == NULL)
+    {
+        return NULL;
     }
 
+    pthread_mutexattr_t lock_attr;
+    pthread_mutexattr_init(&lock_attr);
+    pthread_mutexattr_settype(&lock_attr, PTHREAD_MUTEX_RECURSIVE);
+
+    smbus_inst->i2c_bus = i2c_bus;
+    smbus_inst->bus_index = bus_index;
+    smbus_wire_init(&smbus_inst->wire);
+    atomic_init(&smbus_inst->cancel_generation, 0);
+    pthread_mutex_init(&smbus_inst->lock, &lock_attr);
+
+    pthread_mutexattr_destroy(&lock_attr);
+
     return smbus_inst;
 }
 
@@ -78,7 +94,29 @@ bool smbus_close(
     SMBUS_HANDLE_CHECK(smbus_handle);
     smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
 
+    // Shared with other users of the bus manager
+    if(smbus_inst->is_managed)
+    {
+        errno = EBUSY;
+        return false;
+    }
+
+    return smbus_inst_destroy(smbus_inst);
+}
+
+bool smbus_inst_destroy(
+    smbus_inst_t* smbus_inst
+)
+{
+    // The adapter outlives the handle, a deadline must not leave its timeout lowered
+    smbus_set_deadline(smbus_inst, 0);
+    smbus_rt_stop(smbus_inst);
+    smbus_rp1_destroy(smbus_inst);
+
     int res = close(smbus_inst->i2c_bus);
+    smbus_flight_destroy(smbus_inst);
+    smbus_device_plans_destroy(smbus_inst);
+    pthread_mutex_destroy(&smbus_inst->lock);
     free(smbus_inst);
 
     return (res >= 0);
@@ -92,16 +130,33 @@ bool smbus_use_slave(
     SMBUS_HANDLE_CHECK(smbus_handle);
     smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
 
-    if(ioctl(smbus_inst->i2c_bus, I2C_SLAVE, address) < 0)
+    smbus_inst_lock(smbus_inst);
+
+    if(smbus_ioctl(smbus_inst, I2C_SLAVE, (void*)(unsigned long)address) < 0)
     {
+        smbus_inst_unlock(smbus_inst);
         return false;
     }
 
+    SMBUS_TRACE_SLAVE_SWITCH(smbus_inst->bus_index, smbus_inst->slave_address, address);
+
     smbus_inst->slave_address = address;
 
+    smbus_inst_unlock(smbus_inst);
+
     return true;
 }
 
+uint8_t smbus_get_slave(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    return smbus_inst->slave_address;
+}
+
 bool smbus_set_pec(
     smbus_handle_t smbus_handle,
     bool is_enabled
@@ -110,22 +165,25 @@ bool smbus_set_pec(
     SMBUS_HANDLE_CHECK(smbus_handle);
     smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
 
-    if(is_enabled)
+    // Without adapter PEC support the checksum is handled in software over I2C_RDWR
+    if(is_enabled && (smbus_inst->func_flags & (I2C_FUNC_SMBUS_PEC | I2C_FUNC_I2C)) == 0)
     {
-        unsigned long func_flags = 0;
+        errno = ENOTSUP;
+        return false;
+    }
 
-        ioctl(smbus_inst->i2c_bus, I2C_FUNCS, &func_flags);
+    // The real-time worker mailbox takes one submitter at a time, the lock holder
+    smbus_inst_lock(smbus_inst);
 
-        if((func_flags & I2C_FUNC_SMBUS_PEC) == 0)
-        {
-            errno = ENOTSUP;
-            return false;
-        }
+    if(!is_enabled || (smbus_inst->func_flags & I2C_FUNC_SMBUS_PEC))
+    {
+        smbus_ioctl(smbus_inst, I2C_PEC, (void*)(unsigned long)is_enabled);
     }
 
-    ioctl(smbus_inst->i2c_bus, I2C_PEC, is_enabled);
     smbus_inst->is_pec_enabled = is_enabled;
 
+    smbus_inst_unlock(smbus_inst);
+
     return true;
 }
 
@@ -139,8 +197,171 @@ bool smbus_get_pec(
     return smbus_inst->is_pec_enabled;
 }
 
+bool smbus_get_funcs(
+    smbus_handle_t smbus_handle,
+    unsigned long* func_flags
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    *func_flags = smbus_inst->func_flags;
+
+    return true;
+}
+
+bool smbus_mask_funcs(
+    smbus_handle_t smbus_handle,
+    unsigned long func_flags
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    smbus_inst_lock(smbus_inst);
+    smbus_inst->func_flags &= func_flags;
+    smbus_inst_unlock(smbus_inst);
+
+    return true;
+}
+
+bool smbus_lock(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    smbus_inst_lock(smbus_inst);
+
+    // Advisory lock against other processes which cooperate on the same bus
+    if(smbus_inst->lock_depth == 0 && flock(smbus_inst->i2c_bus, LOCK_EX) < 0)
+    {
+        smbus_inst_unlock(smbus_inst);
+        return false;
+    }
+
+    ++smbus_inst->lock_depth;
+
+    return true;
+}
+
+bool smbus_unlock(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    if(smbus_inst->lock_depth == 0)
+    {
+        errno = EPERM;
+        return false;
+    }
+
+    if(--smbus_inst->lock_depth == 0)
+    {
+        flock(smbus_inst->i2c_bus, LOCK_UN);
+    }
+
+    smbus_inst_unlock(smbus_inst);
+
+    return true;
+}
+
+int smbus_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+)
+{
+    // Only transfers occupy the bus
+    bool is_transfer = (request == I2C_SMBUS || request == I2C_RDWR);
+    int res = 0;
+
+    if(is_transfer && smbus_deadline_check(smbus_inst) < 0)
+    {
+        return -1;
+    }
+
+    uint64_t start_ns = is_transfer ? smbus_wire_now() : 0;
+
+    if(smbus_inst->rt != NULL)
+    {
+        res = smbus_rt_ioctl(smbus_inst, request, arg);
+    }
+    else
+    {
+        res = smbus_backend_ioctl(smbus_inst, request, arg);
+    }
+
+    if(is_transfer)
+    {
+        int error = errno;
+        smbus_wire_account(smbus_inst, request, arg, res, start_ns);
+        // Also after failures, a write may have reached the device before the error
+        smbus_flight_written(smbus_inst, request, arg);
+        errno = (res < 0) ? smbus_deadline_error(smbus_inst, error) : error;
+    }
+
+    return res;
+}
+
+int smbus_backend_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+)
+{
+    if(smbus_inst->rp1 != NULL)
+    {
+        return smbus_rp1_ioctl(smbus_inst, request, arg);
+    }
+
+    return ioctl(smbus_inst->i2c_bus, request, arg);
+}
+
+void smbus_inst_lock(
+    smbus_inst_t* smbus_inst
+)
+{
+    // Sampled before waiting, so a cancel issued meanwhile applies to this holder
+    unsigned generation = atomic_load_explicit(&smbus_inst->cancel_generation, memory_order_acquire);
+
+    pthread_mutex_lock(&smbus_inst->lock);
+
+    if(smbus_inst->hold_depth++ == 0)
+    {
+        smbus_inst->hold_generation = generation;
+    }
+}
+
+void smbus_inst_unlock(
+    smbus_inst_t* smbus_inst
+)
+{
+    --smbus_inst->hold_depth;
+    pthread_mutex_unlock(&smbus_inst->lock);
+}
+
 int smbus_rw_access(
-    uint8_t i2c_bus,
+    smbus_inst_t* smbus_inst,
+    unsigned command_type, 
+    uint8_t read_write, 
+    uint8_t reg,
+    union i2c_smbus_data* data
+)
+{
+    if(smbus_inst->flight != NULL)
+    {
+        return smbus_flight_access(smbus_inst, command_type, read_write, reg, data);
+    }
+
+    return smbus_bus_access(smbus_inst, command_type, read_write, reg, data);
+}
+
+int smbus_bus_access(
+    smbus_inst_t* smbus_inst,
     unsigned command_type, 
     uint8_t read_write, 
     uint8_t reg,
@@ -148,14 +369,30 @@ int smbus_rw_access(
 )
 {
     int res = 0;
-    struct i2c_smbus_ioctl_data args = {
-        .command = reg,
-        .read_write = read_write,
-        .size = command_type,
-        .data = data,
-    };
 
-    res = ioctl(i2c_bus, I2C_SMBUS, &args);
+    smbus_inst_lock(smbus_inst);
+
+    SMBUS_TRACE_TRANSACTION_START(smbus_inst->bus_index, smbus_inst->slave_address, reg, command_type, read_write);
+
+    if(!smbus_is_native(smbus_inst, command_type, read_write))
+    {
+        res = smbus_emul_access(smbus_inst, command_type, read_write, reg, data);
+    }
+    else
+    {
+        struct i2c_smbus_ioctl_data args = {
+            .command = reg,
+            .read_write = read_write,
+            .size = command_type,
+            .data = data,
+        };
+
+        res = smbus_ioctl(smbus_inst, I2C_SMBUS, &args);
+    }
+
+    SMBUS_TRACE_TRANSACTION_END(smbus_inst->bus_index, smbus_inst->slave_address, reg, command_type, (res < 0) ? -errno : res);
+
+    smbus_inst_unlock(smbus_inst);
 
     return res;
 }
@@ -205,7 +442,7 @@ bool smbus_quick_command(
 
     uint8_t read_write = bit ? I2C_SMBUS_READ : I2C_SMBUS_WRITE;
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_QUICK, read_write, 0x00, NULL)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_QUICK, read_write, 0x00, NULL)) < 0)
     {
         return false;
     }
@@ -225,7 +462,7 @@ bool smbus_read_reg(
     union i2c_smbus_data data;
     memset(&data, 0, sizeof(union i2c_smbus_data));
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_BYTE, I2C_SMBUS_READ, 0x00, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_BYTE, I2C_SMBUS_READ, 0x00, &data)) < 0)
     {
         return false;
     }
@@ -244,7 +481,7 @@ bool smbus_write_reg(
     smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
     int res = 0;
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_BYTE, I2C_SMBUS_WRITE, reg, NULL)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_BYTE, I2C_SMBUS_WRITE, reg, NULL)) < 0)
     {
         return false;
     }
@@ -266,7 +503,7 @@ bool smbus_read_byte_data(
     union i2c_smbus_data data;
     memset(&data, 0, sizeof(union i2c_smbus_data));
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_BYTE_DATA, I2C_SMBUS_READ, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_BYTE_DATA, I2C_SMBUS_READ, command, &data)) < 0)
     {
         return false;
     }
@@ -291,7 +528,7 @@ bool smbus_write_byte_data(
 
     data.byte = byte;
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_BYTE_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_BYTE_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
     {
         return false;
     }
@@ -312,7 +549,7 @@ bool smbus_read_word_data(
     union i2c_smbus_data data;
     memset(&data, 0, sizeof(union i2c_smbus_data));
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_WORD_DATA, I2C_SMBUS_READ, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_WORD_DATA, I2C_SMBUS_READ, command, &data)) < 0)
     {
         return false;
     }
@@ -337,7 +574,7 @@ bool smbus_write_word_data(
 
     data.word = word;
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_WORD_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_WORD_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
     {
         return false;
     }
@@ -366,7 +603,7 @@ bool smbus_read_dword_data(
         ++data.block[0];
     }
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_READ, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_READ, command, &data)) < 0)
     {
         return false;
     }
@@ -384,6 +621,8 @@ bool smbus_read_dword_data(
 
         if(calculated_crc != received_crc)
         {
+            SMBUS_TRACE_PEC_MISMATCH(smbus_inst->bus_index, smbus_inst->slave_address, command, received_crc, calculated_crc);
+
             errno = EBADMSG;
             return false;
         }
@@ -422,7 +661,7 @@ bool smbus_write_dword_data(
         data.block[data.block[0]] = crc;
     }
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
     {
         return false;
     }
@@ -450,7 +689,7 @@ bool smbus_read_qword_data(
         ++data.block[0];
     }
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_READ, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_READ, command, &data)) < 0)
     {
         return false;
     }
@@ -468,6 +707,8 @@ bool smbus_read_qword_data(
 
         if(calculated_crc != received_crc)
         {
+            SMBUS_TRACE_PEC_MISMATCH(smbus_inst->bus_index, smbus_inst->slave_address, command, received_crc, calculated_crc);
+
             errno = EBADMSG;
             return false;
         }
@@ -506,7 +747,7 @@ bool smbus_write_qword_data(
         data.block[data.block[0]] = crc;
     }
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_I2C_BLOCK_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
     {
         return false;
     }
@@ -528,7 +769,7 @@ bool smbus_read_block_data(
     union i2c_smbus_data data;
     memset(&data, 0, sizeof(union i2c_smbus_data));
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_BLOCK_DATA, I2C_SMBUS_READ, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_BLOCK_DATA, I2C_SMBUS_READ, command, &data)) < 0)
     {
         return false;
     }
@@ -566,7 +807,7 @@ bool smbus_write_block_data(
     data.block[0] = *length;
     memcpy(&data.block[1], block, data.block[0]);
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_BLOCK_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_BLOCK_DATA, I2C_SMBUS_WRITE, command, &data)) < 0)
     {
         return false;
     }
@@ -590,7 +831,7 @@ bool smbus_proc_call(
 
     data.word = request;
 
-    if((res = smbus_rw_access(smbus_inst->i2c_bus, I2C_SMBUS_PROC_CALL, 0, command, &data)) < 0)
+    if((res = smbus_rw_access(smbus_inst, I2C_SMBUS_PROC_CALL, 0, command, &data)) < 0)
     {
         return false;
     }
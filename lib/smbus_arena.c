@@ -0,0 +1,400 @@
+#include <smbus/smbus_arena.h>
+#include <smbus_inst.h>
+#include <smbus_pec.h>
+#include <smbus_trace.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+// Every read is a write + read message pair
+#define SMBUS_ARENA_CHUNK_MAX (I2C_RDWR_IOCTL_MAX_MSGS / 2)
+// Alignment padding, block length byte, block and PEC
+#define SMBUS_ARENA_SLOT_MAX (sizeof(uint64_t) + SMBUS_BLOCK_MAX + 2)
+
+typedef struct smbus_arena_t
+{
+    uint8_t* buf;
+    size_t read_max;
+}
+smbus_arena_t;
+
+static uint8_t* smbus_arena_place(
+    smbus_arena_t* arena,
+    const smbus_arena_read_t* read,
+    bool has_pec,
+    size_t* offset
+);
+
+static void smbus_arena_prepare(
+    const smbus_arena_read_t* read,
+    bool has_pec,
+    uint8_t* command,
+    uint8_t* data,
+    struct i2c_msg* msgs
+);
+
+static int smbus_arena_complete(
+    smbus_inst_t* smbus_inst,
+    const smbus_arena_read_t* read,
+    bool has_pec,
+    uint8_t* data,
+    smbus_view_t* view
+);
+
+static int smbus_arena_read_single(
+    smbus_inst_t* smbus_inst,
+    const smbus_arena_read_t* read,
+    uint8_t* data,
+    smbus_view_t* view
+);
+
+smbus_arena_handle_t smbus_arena_create(
+    size_t read_max
+)
+{
+    if(read_max == 0)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    smbus_arena_t* arena = calloc(1, sizeof(smbus_arena_t));
+
+    if(arena == NULL)
+    {
+        return NULL;
+    }
+
+    size_t size = (read_max * SMBUS_ARENA_SLOT_MAX + SMBUS_ARENA_ALIGN - 1) & ~(size_t)(SMBUS_ARENA_ALIGN - 1);
+
+    if(posix_memalign((void**)&arena->buf, SMBUS_ARENA_ALIGN, size) != 0)
+    {
+        free(arena);
+
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    arena->read_max = read_max;
+
+    return arena;
+}
+
+void smbus_arena_destroy(
+    smbus_arena_handle_t arena_handle
+)
+{
+    smbus_arena_t* arena = (smbus_arena_t*)arena_handle;
+
+    if(arena == NULL)
+    {
+        return;
+    }
+
+    free(arena->buf);
+    free(arena);
+}
+
+bool smbus_arena_read(
+    smbus_handle_t smbus_handle,
+    smbus_arena_handle_t arena_handle,
+    const smbus_arena_read_t* reads,
+    size_t read_count,
+    smbus_view_t* views
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_arena_t* arena = (smbus_arena_t*)arena_handle;
+
+    if(arena == NULL || (read_count != 0 && (reads == NULL || views == NULL)))
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(read_count > arena->read_max)
+    {
+        errno = ENOBUFS;
+        return false;
+    }
+
+    for(size_t i = 0; i < read_count; ++i)
+    {
+        if(!reads[i].is_block && (reads[i].length == 0 || reads[i].length > SMBUS_BLOCK_MAX))
+        {
+            errno = EINVAL;
+            return false;
+        }
+    }
+
+    smbus_inst_lock(smbus_inst);
+
+    bool has_pec = smbus_inst->is_pec_enabled;
+    bool is_batched = (smbus_inst->func_flags & I2C_FUNC_I2C) != 0;
+    uint8_t slave_address = smbus_inst->slave_address;
+    size_t offset = 0;
+    size_t read_index = 0;
+    int error = 0;
+
+    while(read_index < read_count)
+    {
+        struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+        uint8_t commands[SMBUS_ARENA_CHUNK_MAX];
+        uint8_t* datas[SMBUS_ARENA_CHUNK_MAX];
+        size_t chunk_start = read_index;
+        size_t chunk_len = 0;
+
+        for(; read_index < read_count && chunk_len < SMBUS_ARENA_CHUNK_MAX; ++read_index, ++chunk_len)
+        {
+            datas[chunk_len] = smbus_arena_place(arena, &reads[read_index], has_pec, &offset);
+
+            smbus_arena_prepare(&reads[read_index], has_pec, &commands[chunk_len], datas[chunk_len], &msgs[chunk_len * 2]);
+        }
+
+        unsigned done_count = 0;
+
+        if(is_batched)
+        {
+            smbus_rdwr_submit(smbus_inst, msgs, chunk_len * 2, &done_count);
+        }
+
+        // A failed submission does not tell which read failed, those not known to be
+        // complete are asked again one by one
+        for(size_t i = 0; i < chunk_len; ++i)
+        {
+            const smbus_arena_read_t* read = &reads[chunk_start + i];
+            smbus_view_t* view = &views[chunk_start + i];
+
+            int res = (i * 2 + 2 <= done_count) ?
+                smbus_arena_complete(smbus_inst, read, has_pec, datas[i], view) :
+                smbus_arena_read_single(smbus_inst, read, datas[i], view);
+
+            if(res < 0)
+            {
+                view->data = NULL;
+                view->length = 0;
+                view->status = -errno;
+
+                if(error == 0)
+                {
+                    error = errno;
+                }
+            }
+        }
+    }
+
+    // The SMBus fallback addresses each device through the handle
+    if(smbus_inst->slave_address != slave_address && !smbus_use_slave(smbus_inst, slave_address) && error == 0)
+    {
+        error = errno;
+    }
+
+    smbus_inst_unlock(smbus_inst);
+
+    if(error != 0)
+    {
+        errno = error;
+        return false;
+    }
+
+    return true;
+}
+
+uint8_t* smbus_arena_place(
+    smbus_arena_t* arena,
+    const smbus_arena_read_t* read,
+    bool has_pec,
+    size_t* offset
+)
+{
+    size_t align = sizeof(uint64_t);
+    size_t start = *offset;
+
+    if(read->is_block)
+    {
+        // The length byte goes right before the block, i2c-dev needs room for the largest block
+        start = (start + 1 + align - 1) & ~(align - 1);
+        *offset = start - 1 + (has_pec ? 2 : 1) + SMBUS_BLOCK_MAX;
+    }
+    else
+    {
+        while(align > read->length)
+        {
+            align >>= 1;
+        }
+
+        start = (start + align - 1) & ~(align - 1);
+        *offset = start + read->length + (has_pec ? 1 : 0);
+    }
+
+    return &arena->buf[start];
+}
+
+void smbus_arena_prepare(
+    const smbus_arena_read_t* read,
+    bool has_pec,
+    uint8_t* command,
+    uint8_t* data,
+    struct i2c_msg* msgs
+)
+{
+    *command = read->command;
+
+    msgs[0].addr = read->address;
+    msgs[0].flags = 0;
+    msgs[0].len = 1;
+    msgs[0].buf = command;
+
+    msgs[1].addr = read->address;
+    msgs[1].flags = I2C_M_RD;
+
+    if(read->is_block)
+    {
+        // i2c-dev expects the extra byte count in buf[0], the driver appends the received length
+        msgs[1].flags |= I2C_M_RECV_LEN;
+        msgs[1].buf = data - 1;
+        msgs[1].buf[0] = has_pec ? 2 : 1;
+        msgs[1].len = msgs[1].buf[0] + SMBUS_BLOCK_MAX;
+    }
+    else
+    {
+        msgs[1].buf = data;
+        msgs[1].len = read->length + (has_pec ? 1 : 0);
+    }
+}
+
+int smbus_arena_complete(
+    smbus_inst_t* smbus_inst,
+    const smbus_arena_read_t* read,
+    bool has_pec,
+    uint8_t* data,
+    smbus_view_t* view
+)
+{
+    // Only the tracepoint needs the handle
+    (void)smbus_inst;
+
+    uint8_t length = read->length;
+
+    if(read->is_block)
+    {
+        length = data[-1];
+
+        if(length > SMBUS_BLOCK_MAX)
+        {
+            errno = EPROTO;
+            return -1;
+        }
+    }
+
+    // Checked where the driver left the data
+    if(has_pec)
+    {
+        uint8_t crc = 0;
+
+        crc = smbus_pec_single(crc, (read->address << 1) | I2C_SMBUS_WRITE);
+        crc = smbus_pec_single(crc, read->command);
+        crc = smbus_pec_single(crc, (read->address << 1) | I2C_SMBUS_READ);
+
+        if(read->is_block)
+        {
+            crc = smbus_pec_single(crc, length);
+        }
+
+        crc = smbus_pec_block(crc, data, length);
+
+        if(crc != data[length])
+        {
+            SMBUS_TRACE_PEC_MISMATCH(smbus_inst->bus_index, read->address, read->command, data[length], crc);
+
+            errno = EBADMSG;
+            return -1;
+        }
+    }
+
+    view->data = data;
+    view->length = length;
+    view->status = 0;
+
+    return 0;
+}
+
+int smbus_arena_read_single(
+    smbus_inst_t* smbus_inst,
+    const smbus_arena_read_t* read,
+    uint8_t* data,
+    smbus_view_t* view
+)
+{
+    bool has_pec = smbus_inst->is_pec_enabled;
+
+    if(smbus_inst->func_flags & I2C_FUNC_I2C)
+    {
+        struct i2c_msg msgs[2];
+        uint8_t command = 0;
+
+        smbus_arena_prepare(read, has_pec, &command, data, msgs);
+
+        if(smbus_rdwr_submit(smbus_inst, msgs, 2, NULL) < 0)
+        {
+            return -1;
+        }
+
+        return smbus_arena_complete(smbus_inst, read, has_pec, data, view);
+    }
+
+    // SMBus only adapters copy the result from the ioctl data, the only copy made
+    union i2c_smbus_data buf;
+    unsigned command_type = I2C_SMBUS_I2C_BLOCK_DATA;
+
+    if(read->is_block)
+    {
+        command_type = I2C_SMBUS_BLOCK_DATA;
+    }
+    else if(read->length == 1)
+    {
+        command_type = I2C_SMBUS_BYTE_DATA;
+    }
+    else if(read->length == 2)
+    {
+        command_type = I2C_SMBUS_WORD_DATA;
+    }
+    else
+    {
+        buf.block[0] = read->length + (has_pec ? 1 : 0);
+    }
+
+    if(smbus_inst->slave_address != read->address && !smbus_use_slave(smbus_inst, read->address))
+    {
+        return -1;
+    }
+
+    if(smbus_bus_access(smbus_inst, command_type, I2C_SMBUS_READ, read->command, &buf) < 0)
+    {
+        return -1;
+    }
+
+    switch(command_type)
+    {
+        case I2C_SMBUS_BYTE_DATA:
+            data[0] = buf.byte;
+            break;
+
+        case I2C_SMBUS_WORD_DATA:
+            data[0] = buf.word & 0xFF;
+            data[1] = buf.word >> 8;
+            break;
+
+        case I2C_SMBUS_BLOCK_DATA:
+            memcpy(data - 1, buf.block, buf.block[0] + 1);
+            break;
+
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            memcpy(data, &buf.block[1], buf.block[0]);
+            // Only plain I2C block reads leave the PEC to the caller
+            return smbus_arena_complete(smbus_inst, read, has_pec, data, view);
+    }
+
+    return smbus_arena_complete(smbus_inst, read, false, data, view);
+}
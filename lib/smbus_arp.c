@@ -0,0 +1,694 @@
+#include <smbus/smbus.h>
+#include <smbus/smbus_arp.h>
+#include <smbus_inst.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+// UDID and the device address byte
+#define SMBUS_ARP_UDID_BLOCK_LEN (SMBUS_ARP_UDID_LEN + 1)
+#define SMBUS_ARP_TABLE_PATH_MAX 256
+
+typedef struct smbus_arp_saved_t
+{
+    uint8_t slave_address;
+    bool is_pec_enabled;
+}
+smbus_arp_saved_t;
+
+static bool smbus_arp_begin(
+    smbus_inst_t* smbus_inst,
+    smbus_arp_saved_t* saved
+);
+
+static bool smbus_arp_end(
+    smbus_inst_t* smbus_inst,
+    const smbus_arp_saved_t* saved,
+    bool res
+);
+
+static bool smbus_arp_is_nack(
+    int error
+);
+
+static bool smbus_arp_send(
+    smbus_inst_t* smbus_inst,
+    uint8_t command
+);
+
+static bool smbus_arp_read_udid(
+    smbus_inst_t* smbus_inst,
+    uint8_t command,
+    smbus_arp_device_t* device
+);
+
+static bool smbus_arp_assign(
+    smbus_inst_t* smbus_inst,
+    const uint8_t* udid,
+    uint8_t address
+);
+
+static bool smbus_arp_is_reserved(
+    uint8_t address
+);
+
+static bool smbus_arp_is_answering(
+    smbus_inst_t* smbus_inst,
+    uint8_t address
+);
+
+static smbus_arp_device_t* smbus_arp_find(
+    smbus_arp_table_t* table,
+    const uint8_t* udid
+);
+
+static bool smbus_arp_is_taken(
+    const smbus_arp_table_t* table,
+    uint8_t address,
+    const smbus_arp_device_t* self
+);
+
+static uint8_t smbus_arp_choose_address(
+    smbus_inst_t* smbus_inst,
+    const smbus_arp_table_t* table,
+    const smbus_arp_device_t* entry,
+    const smbus_arp_device_t* device,
+    const uint8_t* pool,
+    size_t pool_size,
+    bool* is_answering
+);
+
+bool smbus_arp_prepare(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_arp_saved_t saved;
+
+    if(!smbus_arp_begin(smbus_inst, &saved))
+    {
+        return false;
+    }
+
+    return smbus_arp_end(smbus_inst, &saved, smbus_arp_send(smbus_inst, SMBUS_ARP_PREPARE));
+}
+
+bool smbus_arp_reset_device(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_arp_saved_t saved;
+
+    if(!smbus_arp_begin(smbus_inst, &saved))
+    {
+        return false;
+    }
+
+    return smbus_arp_end(smbus_inst, &saved, smbus_arp_send(smbus_inst, SMBUS_ARP_RESET_DEVICE));
+}
+
+bool smbus_arp_get_udid(
+    smbus_handle_t smbus_handle,
+    smbus_arp_device_t* device
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_arp_saved_t saved;
+
+    if(!smbus_arp_begin(smbus_inst, &saved))
+    {
+        return false;
+    }
+
+    return smbus_arp_end(smbus_inst, &saved, smbus_arp_read_udid(smbus_inst, SMBUS_ARP_GET_UDID, device));
+}
+
+bool smbus_arp_get_udid_directed(
+    smbus_handle_t smbus_handle,
+    uint8_t address,
+    smbus_arp_device_t* device
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_arp_saved_t saved;
+
+    if(address > 0x7F)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(!smbus_arp_begin(smbus_inst, &saved))
+    {
+        return false;
+    }
+
+    // Directed commands carry the target address in the command code
+    return smbus_arp_end(smbus_inst, &saved, smbus_arp_read_udid(smbus_inst, (address << 1) | 1, device));
+}
+
+bool smbus_arp_assign_address(
+    smbus_handle_t smbus_handle,
+    const uint8_t* udid,
+    uint8_t address
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_arp_saved_t saved;
+
+    if(address > 0x7F)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(!smbus_arp_begin(smbus_inst, &saved))
+    {
+        return false;
+    }
+
+    return smbus_arp_end(smbus_inst, &saved, smbus_arp_assign(smbus_inst, udid, address));
+}
+
+bool smbus_arp_enumerate(
+    smbus_handle_t smbus_handle,
+    smbus_arp_table_t* table,
+    const uint8_t* pool,
+    size_t pool_size
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    uint8_t default_pool[0x80];
+    // Pool addresses found in use by devices outside ARP, probed once per enumeration
+    bool is_answering[0x80] = { false };
+    smbus_arp_saved_t saved;
+    int error = 0;
+
+    if(table == NULL || table->count > SMBUS_ARP_DEVICES_MAX || (pool == NULL && pool_size != 0))
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(pool == NULL)
+    {
+        for(uint8_t address = 0; address < 0x80; ++address)
+        {
+            if(!smbus_arp_is_reserved(address))
+            {
+                default_pool[pool_size++] = address;
+            }
+        }
+
+        pool = default_pool;
+    }
+
+    for(size_t i = 0; i < table->count; ++i)
+    {
+        table->devices[i].is_present = false;
+    }
+
+    if(!smbus_arp_begin(smbus_inst, &saved))
+    {
+        return false;
+    }
+
+    // Nobody acknowledging the device default address means there is nothing to resolve
+    if(!smbus_arp_send(smbus_inst, SMBUS_ARP_PREPARE))
+    {
+        error = smbus_arp_is_nack(errno) ? 0 : errno;
+        errno = error;
+
+        return smbus_arp_end(smbus_inst, &saved, error == 0);
+    }
+
+    uint8_t last_udid[SMBUS_ARP_UDID_LEN];
+
+    // Assigned devices drop out of Get UDID, the loop ends when nobody is left to answer.
+    // A device still answering after its assignment would keep it going, so rounds are
+    // bounded by the devices a bus can hold.
+    for(size_t round = 0; ; ++round)
+    {
+        smbus_arp_device_t device;
+
+        if(!smbus_arp_read_udid(smbus_inst, SMBUS_ARP_GET_UDID, &device))
+        {
+            error = smbus_arp_is_nack(errno) ? 0 : errno;
+            break;
+        }
+
+        if(round == SMBUS_ARP_DEVICES_MAX ||
+            (round != 0 && memcmp(device.udid, last_udid, SMBUS_ARP_UDID_LEN) == 0))
+        {
+            error = EPROTO;
+            break;
+        }
+
+        memcpy(last_udid, device.udid, SMBUS_ARP_UDID_LEN);
+
+        smbus_arp_device_t* entry = smbus_arp_find(table, device.udid);
+
+        if(entry == NULL && table->count == SMBUS_ARP_DEVICES_MAX)
+        {
+            error = ENOSPC;
+            break;
+        }
+
+        uint8_t address = smbus_arp_choose_address(smbus_inst, table, entry, &device, pool, pool_size, is_answering);
+
+        if(address == SMBUS_ARP_NO_ADDRESS)
+        {
+            error = ENOSPC;
+            break;
+        }
+
+        if(!smbus_arp_assign(smbus_inst, device.udid, address))
+        {
+            error = errno;
+            break;
+        }
+
+        if(entry == NULL)
+        {
+            entry = &table->devices[table->count++];
+            memcpy(entry->udid, device.udid, SMBUS_ARP_UDID_LEN);
+        }
+
+        entry->address = address;
+        entry->is_present = true;
+    }
+
+    errno = error;
+
+    return smbus_arp_end(smbus_inst, &saved, error == 0);
+}
+
+bool smbus_arp_restore(
+    smbus_handle_t smbus_handle,
+    smbus_arp_table_t* table
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_arp_saved_t saved;
+    int error = 0;
+
+    if(table == NULL || table->count > SMBUS_ARP_DEVICES_MAX)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(!smbus_arp_begin(smbus_inst, &saved))
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < table->count; ++i)
+    {
+        smbus_arp_device_t* entry = &table->devices[i];
+
+        entry->is_present = smbus_arp_assign(smbus_inst, entry->udid, entry->address);
+
+        if(!entry->is_present && error == 0)
+        {
+            error = errno;
+        }
+    }
+
+    errno = error;
+
+    return smbus_arp_end(smbus_inst, &saved, error == 0);
+}
+
+bool smbus_arp_table_load(
+    smbus_arp_table_t* table,
+    const char* path
+)
+{
+    char line[128];
+
+    if(table == NULL || path == NULL)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    memset(table, 0, sizeof(smbus_arp_table_t));
+
+    FILE* file = fopen(path, "r");
+
+    if(file == NULL)
+    {
+        return false;
+    }
+
+    while(fgets(line, sizeof(line), file) != NULL)
+    {
+        smbus_arp_device_t* entry = &table->devices[table->count];
+        unsigned address = 0;
+        bool is_valid = strlen(line) > SMBUS_ARP_UDID_LEN * 2;
+
+        if(line[0] == '#' || line[0] == '\n')
+        {
+            continue;
+        }
+
+        if(table->count == SMBUS_ARP_DEVICES_MAX)
+        {
+            fclose(file);
+
+            errno = ENOSPC;
+            return false;
+        }
+
+        for(size_t i = 0; i < SMBUS_ARP_UDID_LEN && is_valid; ++i)
+        {
+            is_valid = (sscanf(&line[i * 2], "%2hhx", &entry->udid[i]) == 1);
+        }
+
+        if(!is_valid || sscanf(&line[SMBUS_ARP_UDID_LEN * 2], " %x", &address) != 1 || address > 0x7F)
+        {
+            fclose(file);
+
+            errno = EINVAL;
+            return false;
+        }
+
+        entry->address = address;
+        ++table->count;
+    }
+
+    fclose(file);
+
+    return true;
+}
+
+bool smbus_arp_table_save(
+    const smbus_arp_table_t* table,
+    const char* path
+)
+{
+    char tmp_path[SMBUS_ARP_TABLE_PATH_MAX];
+
+    if(table == NULL || path == NULL || table->count > SMBUS_ARP_DEVICES_MAX)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path) >= (int)sizeof(tmp_path))
+    {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    FILE* file = fopen(tmp_path, "w");
+
+    if(file == NULL)
+    {
+        return false;
+    }
+
+    fprintf(file, "# SMBus ARP table: UDID address\n");
+
+    for(size_t i = 0; i < table->count; ++i)
+    {
+        const smbus_arp_device_t* entry = &table->devices[i];
+
+        for(size_t j = 0; j < SMBUS_ARP_UDID_LEN; ++j)
+        {
+            fprintf(file, "%02x", entry->udid[j]);
+        }
+
+        fprintf(file, " 0x%02x\n", entry->address);
+    }
+
+    // A crash leaves either the old table or the new one, never half of it
+    if(fflush(file) != 0 || fsync(fileno(file)) < 0)
+    {
+        int error = errno;
+        fclose(file);
+        unlink(tmp_path);
+
+        errno = error;
+        return false;
+    }
+
+    if(fclose(file) != 0 || rename(tmp_path, path) < 0)
+    {
+        int error = errno;
+        unlink(tmp_path);
+
+        errno = error;
+        return false;
+    }
+
+    return true;
+}
+
+bool smbus_arp_begin(
+    smbus_inst_t* smbus_inst,
+    smbus_arp_saved_t* saved
+)
+{
+    if(!smbus_lock(smbus_inst))
+    {
+        return false;
+    }
+
+    saved->slave_address = smbus_inst->slave_address;
+    saved->is_pec_enabled = smbus_inst->is_pec_enabled;
+
+    if(!smbus_use_slave(smbus_inst, SMBUS_ARP_ADDRESS) || !smbus_set_pec(smbus_inst, true))
+    {
+        return smbus_arp_end(smbus_inst, saved, false);
+    }
+
+    return true;
+}
+
+bool smbus_arp_end(
+    smbus_inst_t* smbus_inst,
+    const smbus_arp_saved_t* saved,
+    bool res
+)
+{
+    int error = errno;
+
+    if(!smbus_set_pec(smbus_inst, saved->is_pec_enabled) && res)
+    {
+        error = errno;
+        res = false;
+    }
+
+    if(!smbus_use_slave(smbus_inst, saved->slave_address) && res)
+    {
+        error = errno;
+        res = false;
+    }
+
+    smbus_unlock(smbus_inst);
+
+    errno = error;
+
+    return res;
+}
+
+bool smbus_arp_is_nack(
+    int error
+)
+{
+    // i2c-dev drivers disagree on the code of an unacknowledged address
+    return error == ENXIO || error == EREMOTEIO;
+}
+
+bool smbus_arp_send(
+    smbus_inst_t* smbus_inst,
+    uint8_t command
+)
+{
+    return smbus_bus_access(smbus_inst, I2C_SMBUS_BYTE, I2C_SMBUS_WRITE, command, NULL) >= 0;
+}
+
+bool smbus_arp_read_udid(
+    smbus_inst_t* smbus_inst,
+    uint8_t command,
+    smbus_arp_device_t* device
+)
+{
+    union i2c_smbus_data data;
+
+    if(smbus_bus_access(smbus_inst, I2C_SMBUS_BLOCK_DATA, I2C_SMBUS_READ, command, &data) < 0)
+    {
+        return false;
+    }
+
+    if(data.block[0] != SMBUS_ARP_UDID_BLOCK_LEN)
+    {
+        errno = EPROTO;
+        return false;
+    }
+
+    memcpy(device->udid, &data.block[1], SMBUS_ARP_UDID_LEN);
+
+    // Assigned addresses come back shifted with the read bit set
+    uint8_t address_byte = data.block[SMBUS_ARP_UDID_BLOCK_LEN];
+    device->address = (address_byte == SMBUS_ARP_NO_ADDRESS) ? SMBUS_ARP_NO_ADDRESS : address_byte >> 1;
+    device->is_present = true;
+
+    return true;
+}
+
+bool smbus_arp_assign(
+    smbus_inst_t* smbus_inst,
+    const uint8_t* udid,
+    uint8_t address
+)
+{
+    union i2c_smbus_data data;
+
+    data.block[0] = SMBUS_ARP_UDID_BLOCK_LEN;
+    memcpy(&data.block[1], udid, SMBUS_ARP_UDID_LEN);
+    data.block[SMBUS_ARP_UDID_BLOCK_LEN] = address << 1;
+
+    return smbus_bus_access(smbus_inst, I2C_SMBUS_BLOCK_DATA, I2C_SMBUS_WRITE, SMBUS_ARP_ASSIGN_ADDRESS, &data) >= 0;
+}
+
+bool smbus_arp_is_reserved(
+    uint8_t address
+)
+{
+    switch(address)
+    {
+        // SMBus host, Smart Battery charger, selector and battery, Alert Response
+        case 0x08:
+        case 0x09:
+        case 0x0A:
+        case 0x0B:
+        case 0x0C:
+        // ACCESS.bus host, reserved by previous SMBus versions, ACCESS.bus default
+        case 0x28:
+        case 0x2C:
+        case 0x2D:
+        case 0x37:
+        // Device default
+        case SMBUS_ARP_ADDRESS:
+            return true;
+    }
+
+    // General call, CBUS, HS-mode and 10-bit prefixes, reserved by previous SMBus versions
+    return address < 0x08 || address > 0x77 || (address >= 0x48 && address <= 0x4B);
+}
+
+bool smbus_arp_is_answering(
+    smbus_inst_t* smbus_inst,
+    uint8_t address
+)
+{
+    union i2c_smbus_data data;
+
+    // Receive Byte changes no device state, anything but a NACK counts as an answer
+    if(!smbus_use_slave(smbus_inst, address))
+    {
+        return true;
+    }
+
+    bool res = smbus_bus_access(smbus_inst, I2C_SMBUS_BYTE, I2C_SMBUS_READ, 0, &data) >= 0 ||
+        !smbus_arp_is_nack(errno);
+
+    if(!smbus_use_slave(smbus_inst, SMBUS_ARP_ADDRESS))
+    {
+        return true;
+    }
+
+    return res;
+}
+
+smbus_arp_device_t* smbus_arp_find(
+    smbus_arp_table_t* table,
+    const uint8_t* udid
+)
+{
+    for(size_t i = 0; i < table->count; ++i)
+    {
+        if(memcmp(table->devices[i].udid, udid, SMBUS_ARP_UDID_LEN) == 0)
+        {
+            return &table->devices[i];
+        }
+    }
+
+    return NULL;
+}
+
+bool smbus_arp_is_taken(
+    const smbus_arp_table_t* table,
+    uint8_t address,
+    const smbus_arp_device_t* self
+)
+{
+    // Addresses of known devices stay reserved while they are away
+    for(size_t i = 0; i < table->count; ++i)
+    {
+        if(&table->devices[i] != self && table->devices[i].address == address)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+uint8_t smbus_arp_choose_address(
+    smbus_inst_t* smbus_inst,
+    const smbus_arp_table_t* table,
+    const smbus_arp_device_t* entry,
+    const smbus_arp_device_t* device,
+    const uint8_t* pool,
+    size_t pool_size,
+    bool* is_answering
+)
+{
+    if(entry != NULL && !smbus_arp_is_taken(table, entry->address, entry))
+    {
+        return entry->address;
+    }
+
+    unsigned address_type = SMBUS_ARP_ADDRESS_TYPE(device->udid);
+
+    if(device->address != SMBUS_ARP_NO_ADDRESS &&
+        (address_type == SMBUS_ARP_FIXED || address_type == SMBUS_ARP_DYNAMIC_PERSISTENT) &&
+        !smbus_arp_is_taken(table, device->address, entry))
+    {
+        return device->address;
+    }
+
+    // A pool address may already belong to a fixed device which does not take part in ARP
+    for(size_t i = 0; i < pool_size; ++i)
+    {
+        uint8_t address = pool[i];
+
+        if(address > 0x7F || smbus_arp_is_taken(table, address, entry) || is_answering[address])
+        {
+            continue;
+        }
+
+        if(smbus_arp_is_answering(smbus_inst, address))
+        {
+            is_answering[address] = true;
+            continue;
+        }
+
+        return address;
+    }
+
+    return SMBUS_ARP_NO_ADDRESS;
+}
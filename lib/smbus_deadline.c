@@ -0,0 +1,158 @@
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <errno.h>
+
+// I2C_TIMEOUT counts in 10 ms units
+#define SMBUS_DEADLINE_UNIT_NS 10000000ULL
+// Adapter timeout restored once deadlines are cleared, the kernel default of 1 s
+#define SMBUS_DEADLINE_DEFAULT_UNITS 100
+
+// Deadline of the calling thread, bounding only its own transfers on that one handle
+static _Thread_local const smbus_inst_t* smbus_deadline_inst = NULL;
+static _Thread_local uint64_t smbus_deadline_ns = 0;
+
+static uint64_t smbus_deadline_get(
+    const smbus_inst_t* smbus_inst
+);
+
+uint64_t smbus_deadline_after_us(
+    uint64_t timeout_us
+)
+{
+    return smbus_wire_now() + timeout_us * 1000ULL;
+}
+
+bool smbus_set_deadline(
+    smbus_handle_t smbus_handle,
+    uint64_t deadline_ns
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    if(deadline_ns != 0)
+    {
+        smbus_deadline_inst = smbus_inst;
+        smbus_deadline_ns = deadline_ns;
+
+        return true;
+    }
+
+    if(smbus_deadline_inst == smbus_inst)
+    {
+        smbus_deadline_inst = NULL;
+        smbus_deadline_ns = 0;
+    }
+
+    // The adapter timeout is shared, transfers of other threads set it again as they need
+    smbus_inst_lock(smbus_inst);
+    smbus_deadline_restore(smbus_inst);
+    smbus_inst_unlock(smbus_inst);
+
+    return true;
+}
+
+uint64_t smbus_get_deadline(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    return smbus_deadline_get(smbus_inst);
+}
+
+uint64_t smbus_deadline_get(
+    const smbus_inst_t* smbus_inst
+)
+{
+    return (smbus_deadline_inst == smbus_inst) ? smbus_deadline_ns : 0;
+}
+
+bool smbus_cancel(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    // Never takes the lock, its holder is what is being cancelled
+    atomic_fetch_add_explicit(&smbus_inst->cancel_generation, 1, memory_order_release);
+
+    return true;
+}
+
+int smbus_deadline_check(
+    smbus_inst_t* smbus_inst
+)
+{
+    if(atomic_load_explicit(&smbus_inst->cancel_generation, memory_order_acquire) != smbus_inst->hold_generation)
+    {
+        errno = ECANCELED;
+        return -1;
+    }
+
+    uint64_t deadline_ns = smbus_deadline_get(smbus_inst);
+
+    // The adapter timeout may still be lowered by a deadline of another thread
+    if(deadline_ns == 0)
+    {
+        smbus_deadline_restore(smbus_inst);
+        return 0;
+    }
+
+    uint64_t now_ns = smbus_wire_now();
+
+    if(now_ns >= deadline_ns)
+    {
+        smbus_deadline_restore(smbus_inst);
+
+        errno = ETIME;
+        return -1;
+    }
+
+    // Rounded up, the adapter gives up no earlier than the deadline
+    unsigned long units = (deadline_ns - now_ns + SMBUS_DEADLINE_UNIT_NS - 1) / SMBUS_DEADLINE_UNIT_NS;
+
+    // The timeout belongs to the adapter, so it is only touched when it changes
+    if(units != smbus_inst->timeout_units &&
+        smbus_ioctl(smbus_inst, I2C_TIMEOUT, (void*)units) >= 0)
+    {
+        smbus_inst->timeout_units = units;
+    }
+
+    return 0;
+}
+
+int smbus_deadline_error(
+    smbus_inst_t* smbus_inst,
+    int error
+)
+{
+    uint64_t deadline_ns = smbus_deadline_get(smbus_inst);
+
+    if(deadline_ns == 0 || smbus_wire_now() < deadline_ns)
+    {
+        return error;
+    }
+
+    // Other users of the adapter must not keep the short timeout of a spent deadline
+    smbus_deadline_restore(smbus_inst);
+
+    return (error == ETIMEDOUT) ? ETIME : error;
+}
+
+void smbus_deadline_restore(
+    smbus_inst_t* smbus_inst
+)
+{
+    if(smbus_inst->timeout_units == 0)
+    {
+        return;
+    }
+
+    if(smbus_ioctl(smbus_inst, I2C_TIMEOUT, (void*)(unsigned long)SMBUS_DEADLINE_DEFAULT_UNITS) >= 0)
+    {
+        smbus_inst->timeout_units = 0;
+    }
+}
@@ -0,0 +1,557 @@
+#include <smbus/smbus_device.h>
+#include <smbus_inst.h>
+#include <smbus_trace.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+struct smbus_device_plan_t
+{
+    const smbus_device_desc_t* device_desc;
+    bool volatile_only;
+    // Handle settings the messages were prepared for
+    uint8_t slave_address;
+    bool is_pec_enabled;
+    size_t reg_count;
+    const smbus_reg_desc_t** regs;
+    smbus_emul_t* emuls;
+    // Messages of every read in submission order, pointing into emuls
+    struct i2c_msg* msgs;
+    unsigned msg_count;
+    // Next plan kept by the same handle
+    smbus_device_plan_t* next;
+};
+
+static smbus_device_plan_t* smbus_device_plan_alloc(
+    const smbus_device_desc_t* device_desc,
+    bool volatile_only
+);
+
+static void smbus_device_plan_free(
+    smbus_device_plan_t* plan
+);
+
+static int smbus_device_reg_compare(
+    const void* left,
+    const void* right
+);
+
+static int smbus_device_plan_compile(
+    smbus_inst_t* smbus_inst,
+    smbus_device_plan_t* plan
+);
+
+static bool smbus_device_plan_run(
+    smbus_inst_t* smbus_inst,
+    smbus_device_plan_t* plan,
+    uint8_t* snapshot
+);
+
+static bool smbus_device_read(
+    smbus_inst_t* smbus_inst,
+    const smbus_device_desc_t* device_desc,
+    uint8_t* snapshot,
+    bool volatile_only
+);
+
+static bool smbus_device_read_single(
+    smbus_inst_t* smbus_inst,
+    const smbus_reg_desc_t* reg,
+    uint8_t* field
+);
+
+static bool smbus_device_is_planned(
+    const smbus_reg_desc_t* reg,
+    bool volatile_only
+);
+
+static int smbus_device_prepare(
+    smbus_inst_t* smbus_inst,
+    const smbus_reg_desc_t* reg,
+    smbus_emul_t* emul
+);
+
+static int smbus_device_complete(
+    smbus_inst_t* smbus_inst,
+    const smbus_reg_desc_t* reg,
+    smbus_emul_t* emul,
+    uint8_t* field
+);
+
+bool smbus_device_read_all(
+    smbus_handle_t smbus_handle,
+    const smbus_device_desc_t* device_desc,
+    void* snapshot
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    smbus_inst_lock(smbus_inst);
+    bool res = smbus_device_read(smbus_inst, device_desc, snapshot, false);
+    smbus_inst_unlock(smbus_inst);
+
+    return res;
+}
+
+bool smbus_device_read_volatile(
+    smbus_handle_t smbus_handle,
+    const smbus_device_desc_t* device_desc,
+    void* snapshot
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    smbus_inst_lock(smbus_inst);
+    bool res = smbus_device_read(smbus_inst, device_desc, snapshot, true);
+    smbus_inst_unlock(smbus_inst);
+
+    return res;
+}
+
+smbus_device_plan_handle_t smbus_device_plan_create(
+    smbus_handle_t smbus_handle,
+    const smbus_device_desc_t* device_desc,
+    bool volatile_only
+)
+{
+    if(smbus_handle == NULL || device_desc == NULL)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_device_plan_t* plan = smbus_device_plan_alloc(device_desc, volatile_only);
+
+    if(plan == NULL)
+    {
+        return NULL;
+    }
+
+    smbus_inst_lock(smbus_inst);
+    int res = smbus_device_plan_compile(smbus_inst, plan);
+    smbus_inst_unlock(smbus_inst);
+
+    if(res < 0)
+    {
+        int error = errno;
+        smbus_device_plan_free(plan);
+
+        errno = error;
+        return NULL;
+    }
+
+    return plan;
+}
+
+void smbus_device_plan_destroy(
+    smbus_device_plan_handle_t plan_handle
+)
+{
+    smbus_device_plan_free((smbus_device_plan_t*)plan_handle);
+}
+
+bool smbus_device_plan_read(
+    smbus_handle_t smbus_handle,
+    smbus_device_plan_handle_t plan_handle,
+    void* snapshot
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_device_plan_t* plan = (smbus_device_plan_t*)plan_handle;
+
+    if(plan == NULL)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    smbus_inst_lock(smbus_inst);
+    bool res = smbus_device_plan_run(smbus_inst, plan, snapshot);
+    smbus_inst_unlock(smbus_inst);
+
+    return res;
+}
+
+void smbus_device_plans_destroy(
+    smbus_inst_t* smbus_inst
+)
+{
+    while(smbus_inst->device_plans != NULL)
+    {
+        smbus_device_plan_t* plan = smbus_inst->device_plans;
+        smbus_inst->device_plans = plan->next;
+
+        smbus_device_plan_free(plan);
+    }
+}
+
+smbus_device_plan_t* smbus_device_plan_alloc(
+    const smbus_device_desc_t* device_desc,
+    bool volatile_only
+)
+{
+    smbus_device_plan_t* plan = calloc(1, sizeof(smbus_device_plan_t));
+
+    if(plan == NULL)
+    {
+        return NULL;
+    }
+
+    plan->device_desc = device_desc;
+    plan->volatile_only = volatile_only;
+
+    for(size_t i = 0; i < device_desc->reg_count; ++i)
+    {
+        if(smbus_device_is_planned(&device_desc->regs[i], volatile_only))
+        {
+            ++plan->reg_count;
+        }
+    }
+
+    if(plan->reg_count == 0)
+    {
+        return plan;
+    }
+
+    // Each register read is a write + read message pair
+    plan->regs = calloc(plan->reg_count, sizeof(const smbus_reg_desc_t*));
+    plan->emuls = calloc(plan->reg_count, sizeof(smbus_emul_t));
+    plan->msgs = calloc(plan->reg_count * 2, sizeof(struct i2c_msg));
+
+    if(plan->regs == NULL || plan->emuls == NULL || plan->msgs == NULL)
+    {
+        smbus_device_plan_free(plan);
+
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    for(size_t i = 0, reg_index = 0; i < device_desc->reg_count; ++i)
+    {
+        if(smbus_device_is_planned(&device_desc->regs[i], volatile_only))
+        {
+            plan->regs[reg_index++] = &device_desc->regs[i];
+        }
+    }
+
+    // Consecutive commands go out next to each other whatever the descriptor order
+    qsort(plan->regs, plan->reg_count, sizeof(const smbus_reg_desc_t*), smbus_device_reg_compare);
+
+    return plan;
+}
+
+int smbus_device_reg_compare(
+    const void* left,
+    const void* right
+)
+{
+    const smbus_reg_desc_t* left_reg = *(const smbus_reg_desc_t* const*)left;
+    const smbus_reg_desc_t* right_reg = *(const smbus_reg_desc_t* const*)right;
+
+    if(left_reg->command != right_reg->command)
+    {
+        return (left_reg->command < right_reg->command) ? -1 : 1;
+    }
+
+    // Registers of one table, a repeated command keeps its descriptor order
+    return (left_reg < right_reg) ? -1 : (left_reg > right_reg);
+}
+
+void smbus_device_plan_free(
+    smbus_device_plan_t* plan
+)
+{
+    if(plan == NULL)
+    {
+        return;
+    }
+
+    free(plan->regs);
+    free(plan->emuls);
+    free(plan->msgs);
+    free(plan);
+}
+
+int smbus_device_plan_compile(
+    smbus_inst_t* smbus_inst,
+    smbus_device_plan_t* plan
+)
+{
+    plan->msg_count = 0;
+
+    for(size_t i = 0; i < plan->reg_count; ++i)
+    {
+        smbus_emul_t* emul = &plan->emuls[i];
+
+        if(smbus_device_prepare(smbus_inst, plan->regs[i], emul) < 0)
+        {
+            return -1;
+        }
+
+        memcpy(&plan->msgs[plan->msg_count], emul->msgs, emul->msg_count * sizeof(struct i2c_msg));
+        plan->msg_count += emul->msg_count;
+    }
+
+    plan->slave_address = smbus_inst->slave_address;
+    plan->is_pec_enabled = smbus_inst->is_pec_enabled;
+
+    return 0;
+}
+
+bool smbus_device_plan_run(
+    smbus_inst_t* smbus_inst,
+    smbus_device_plan_t* plan,
+    uint8_t* snapshot
+)
+{
+    // Adapters without plain I2C transfers fall back to one SMBus call per register
+    if((smbus_inst->func_flags & I2C_FUNC_I2C) == 0)
+    {
+        for(size_t i = 0; i < plan->reg_count; ++i)
+        {
+            if(!smbus_device_read_single(smbus_inst, plan->regs[i], &snapshot[plan->regs[i]->offset]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    if(plan->slave_address != smbus_inst->slave_address || plan->is_pec_enabled != smbus_inst->is_pec_enabled)
+    {
+        if(smbus_device_plan_compile(smbus_inst, plan) < 0)
+        {
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < plan->reg_count; ++i)
+    {
+        // The driver leaves the received length where block reads expect their extra byte count
+        if(plan->regs[i]->type == SMBUS_REG_BLOCK)
+        {
+            plan->emuls[i].read_buf[0] = plan->is_pec_enabled ? 2 : 1;
+        }
+    }
+
+    // Registers are message pairs, a full submission never splits one
+    for(unsigned msg_index = 0; msg_index < plan->msg_count; msg_index += I2C_RDWR_IOCTL_MAX_MSGS)
+    {
+        unsigned msg_count = plan->msg_count - msg_index;
+
+        if(msg_count > I2C_RDWR_IOCTL_MAX_MSGS)
+        {
+            msg_count = I2C_RDWR_IOCTL_MAX_MSGS;
+        }
+
+        if(smbus_rdwr_submit(smbus_inst, &plan->msgs[msg_index], msg_count, NULL) < 0)
+        {
+            return false;
+        }
+    }
+
+    for(size_t i = 0; i < plan->reg_count; ++i)
+    {
+        if(smbus_device_complete(smbus_inst, plan->regs[i], &plan->emuls[i], &snapshot[plan->regs[i]->offset]) < 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool smbus_device_is_planned(
+    const smbus_reg_desc_t* reg,
+    bool volatile_only
+)
+{
+    if((reg->access & SMBUS_REG_RO) == 0)
+    {
+        return false;
+    }
+
+    return !volatile_only || reg->volatility == SMBUS_REG_VOLATILE;
+}
+
+bool smbus_device_read(
+    smbus_inst_t* smbus_inst,
+    const smbus_device_desc_t* device_desc,
+    uint8_t* snapshot,
+    bool volatile_only
+)
+{
+    smbus_device_plan_t* plan = smbus_inst->device_plans;
+
+    while(plan != NULL && (plan->device_desc != device_desc || plan->volatile_only != volatile_only))
+    {
+        plan = plan->next;
+    }
+
+    if(plan == NULL)
+    {
+        plan = smbus_device_plan_alloc(device_desc, volatile_only);
+
+        if(plan == NULL)
+        {
+            return false;
+        }
+
+        if(smbus_device_plan_compile(smbus_inst, plan) < 0)
+        {
+            int error = errno;
+            smbus_device_plan_free(plan);
+
+            errno = error;
+            return false;
+        }
+
+        plan->next = smbus_inst->device_plans;
+        smbus_inst->device_plans = plan;
+    }
+
+    return smbus_device_plan_run(smbus_inst, plan, snapshot);
+}
+
+bool smbus_device_read_single(
+    smbus_inst_t* smbus_inst,
+    const smbus_reg_desc_t* reg,
+    uint8_t* field
+)
+{
+    switch(reg->type)
+    {
+        case SMBUS_REG_BYTE:
+            return smbus_reg_read_BYTE(smbus_inst, reg->command, (uint8_t*)field);
+        case SMBUS_REG_WORD:
+            return smbus_reg_read_WORD(smbus_inst, reg->command, (uint16_t*)field);
+        case SMBUS_REG_DWORD:
+            return smbus_reg_read_DWORD(smbus_inst, reg->command, (uint32_t*)field);
+        case SMBUS_REG_QWORD:
+            return smbus_reg_read_QWORD(smbus_inst, reg->command, (uint64_t*)field);
+        case SMBUS_REG_BLOCK:
+            return smbus_reg_read_BLOCK(smbus_inst, reg->command, (smbus_block_t*)field);
+    }
+
+    errno = EINVAL;
+    return false;
+}
+
+int smbus_device_prepare(
+    smbus_inst_t* smbus_inst,
+    const smbus_reg_desc_t* reg,
+    smbus_emul_t* emul
+)
+{
+    union i2c_smbus_data data;
+    unsigned command_type = 0;
+
+    switch(reg->type)
+    {
+        case SMBUS_REG_BYTE:
+            command_type = I2C_SMBUS_BYTE_DATA;
+            break;
+        case SMBUS_REG_WORD:
+            command_type = I2C_SMBUS_WORD_DATA;
+            break;
+        case SMBUS_REG_DWORD:
+        case SMBUS_REG_QWORD:
+            // Same framing as smbus_read_dword_data/smbus_read_qword_data
+            command_type = I2C_SMBUS_I2C_BLOCK_DATA;
+            data.block[0] = (reg->type == SMBUS_REG_DWORD) ? sizeof(uint32_t) : sizeof(uint64_t);
+
+            if(smbus_inst->is_pec_enabled)
+            {
+                ++data.block[0];
+            }
+            break;
+        case SMBUS_REG_BLOCK:
+            command_type = I2C_SMBUS_BLOCK_DATA;
+            break;
+        default:
+            errno = EINVAL;
+            return -1;
+    }
+
+    return smbus_emul_prepare(
+        emul,
+        smbus_inst->slave_address,
+        smbus_inst->is_pec_enabled,
+        command_type,
+        I2C_SMBUS_READ,
+        reg->command,
+        &data
+    );
+}
+
+int smbus_device_complete(
+    smbus_inst_t* smbus_inst,
+    const smbus_reg_desc_t* reg,
+    smbus_emul_t* emul,
+    uint8_t* field
+)
+{
+    union i2c_smbus_data data;
+
+    if(reg->type == SMBUS_REG_DWORD || reg->type == SMBUS_REG_QWORD)
+    {
+        data.block[0] = emul->msgs[1].len;
+    }
+
+    if(smbus_emul_complete(smbus_inst, emul, &data) < 0)
+    {
+        return -1;
+    }
+
+    switch(reg->type)
+    {
+        case SMBUS_REG_BYTE:
+            *field = data.byte;
+            break;
+
+        case SMBUS_REG_WORD:
+            memcpy(field, &data.word, sizeof(uint16_t));
+            break;
+
+        case SMBUS_REG_DWORD:
+        case SMBUS_REG_QWORD:
+            if(smbus_inst->is_pec_enabled)
+            {
+                uint8_t received_crc = data.block[data.block[0]];
+                --data.block[0];
+
+                uint8_t calculated_crc = smbus_calc_i2c_read_block_pec(
+                    smbus_inst->slave_address,
+                    reg->command,
+                    data.block
+                );
+
+                if(calculated_crc != received_crc)
+                {
+                    SMBUS_TRACE_PEC_MISMATCH(smbus_inst->bus_index, smbus_inst->slave_address, reg->command, received_crc, calculated_crc);
+
+                    errno = EBADMSG;
+                    return -1;
+                }
+            }
+
+            memcpy(field, &data.block[1], data.block[0]);
+            break;
+
+        case SMBUS_REG_BLOCK:
+        {
+            smbus_block_t* block = (smbus_block_t*)field;
+
+            block->length = data.block[0];
+            memcpy(block->data, &data.block[1], data.block[0]);
+            break;
+        }
+    }
+
+    return 0;
+}
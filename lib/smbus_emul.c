@@ -0,0 +1,527 @@
+#include <smbus_inst.h>
+#include <smbus_pec.h>
+#include <smbus_trace.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+
+static uint8_t smbus_emul_msg_pec(
+    uint8_t crc,
+    struct i2c_msg* msg,
+    uint16_t len
+);
+
+static bool smbus_emul_has_pec(
+    smbus_emul_t* emul
+);
+
+static int smbus_rdwr_ioctl(
+    smbus_inst_t* smbus_inst,
+    struct i2c_msg* msgs,
+    unsigned msg_count
+);
+
+bool smbus_is_native(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t read_write
+)
+{
+    unsigned long required = 0;
+    bool is_read = (read_write == I2C_SMBUS_READ);
+
+    switch(command_type)
+    {
+        case I2C_SMBUS_QUICK:
+            required = I2C_FUNC_SMBUS_QUICK;
+            break;
+        case I2C_SMBUS_BYTE:
+            required = is_read ? I2C_FUNC_SMBUS_READ_BYTE : I2C_FUNC_SMBUS_WRITE_BYTE;
+            break;
+        case I2C_SMBUS_BYTE_DATA:
+            required = is_read ? I2C_FUNC_SMBUS_READ_BYTE_DATA : I2C_FUNC_SMBUS_WRITE_BYTE_DATA;
+            break;
+        case I2C_SMBUS_WORD_DATA:
+            required = is_read ? I2C_FUNC_SMBUS_READ_WORD_DATA : I2C_FUNC_SMBUS_WRITE_WORD_DATA;
+            break;
+        case I2C_SMBUS_PROC_CALL:
+            required = I2C_FUNC_SMBUS_PROC_CALL;
+            break;
+        case I2C_SMBUS_BLOCK_DATA:
+            required = is_read ? I2C_FUNC_SMBUS_READ_BLOCK_DATA : I2C_FUNC_SMBUS_WRITE_BLOCK_DATA;
+            break;
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            required = is_read ? I2C_FUNC_SMBUS_READ_I2C_BLOCK : I2C_FUNC_SMBUS_WRITE_I2C_BLOCK;
+            break;
+        default:
+            return true;
+    }
+
+    // Kernel PEC applies to everything but quick and I2C block transfers
+    if(smbus_inst->is_pec_enabled &&
+        command_type != I2C_SMBUS_QUICK &&
+        command_type != I2C_SMBUS_I2C_BLOCK_DATA)
+    {
+        required |= I2C_FUNC_SMBUS_PEC;
+    }
+
+    return (smbus_inst->func_flags & required) == required;
+}
+
+uint8_t smbus_emul_msg_pec(
+    uint8_t crc,
+    struct i2c_msg* msg,
+    uint16_t len
+)
+{
+    uint8_t address = (msg->addr << 1) | ((msg->flags & I2C_M_RD) ? I2C_SMBUS_READ : I2C_SMBUS_WRITE);
+
+    crc = smbus_pec_single(crc, address);
+    crc = smbus_pec_block(crc, msg->buf, len);
+
+    return crc;
+}
+
+bool smbus_emul_has_pec(
+    smbus_emul_t* emul
+)
+{
+    return emul->is_pec_enabled &&
+        emul->command_type != I2C_SMBUS_QUICK &&
+        emul->command_type != I2C_SMBUS_I2C_BLOCK_DATA;
+}
+
+int smbus_emul_prepare(
+    smbus_emul_t* emul,
+    uint8_t slave_address,
+    bool is_pec_enabled,
+    unsigned command_type,
+    uint8_t read_write,
+    uint8_t command,
+    union i2c_smbus_data* data
+)
+{
+    struct i2c_msg* write_msg = &emul->msgs[0];
+    struct i2c_msg* read_msg = &emul->msgs[1];
+
+    // Process call is always write followed by read
+    if(command_type == I2C_SMBUS_PROC_CALL)
+    {
+        read_write = I2C_SMBUS_READ;
+    }
+
+    emul->command_type = command_type;
+    emul->read_write = read_write;
+    emul->is_pec_enabled = is_pec_enabled;
+
+    write_msg->addr = slave_address;
+    write_msg->flags = 0;
+    write_msg->len = 1;
+    write_msg->buf = emul->write_buf;
+    write_msg->buf[0] = command;
+
+    read_msg->addr = slave_address;
+    read_msg->flags = I2C_M_RD;
+    read_msg->len = 0;
+    read_msg->buf = emul->read_buf;
+
+    emul->msg_count = (read_write == I2C_SMBUS_READ) ? 2 : 1;
+
+    switch(command_type)
+    {
+        case I2C_SMBUS_QUICK:
+            write_msg->len = 0;
+            write_msg->flags = (read_write == I2C_SMBUS_READ) ? I2C_M_RD : 0;
+            emul->msg_count = 1;
+            break;
+
+        case I2C_SMBUS_BYTE:
+            if(read_write == I2C_SMBUS_READ)
+            {
+                // Plain receive byte, no command phase
+                emul->msgs[0] = *read_msg;
+                emul->msgs[0].len = 1;
+                emul->msg_count = 1;
+            }
+            break;
+
+        case I2C_SMBUS_BYTE_DATA:
+            if(read_write == I2C_SMBUS_READ)
+            {
+                read_msg->len = 1;
+            }
+            else
+            {
+                write_msg->len = 2;
+                write_msg->buf[1] = data->byte;
+            }
+            break;
+
+        case I2C_SMBUS_WORD_DATA:
+        case I2C_SMBUS_PROC_CALL:
+            if(read_write == I2C_SMBUS_READ)
+            {
+                read_msg->len = 2;
+            }
+
+            if(read_write == I2C_SMBUS_WRITE || command_type == I2C_SMBUS_PROC_CALL)
+            {
+                write_msg->len = 3;
+                write_msg->buf[1] = data->word & 0xFF;
+                write_msg->buf[2] = data->word >> 8;
+            }
+            break;
+
+        case I2C_SMBUS_BLOCK_DATA:
+            if(read_write == I2C_SMBUS_READ)
+            {
+                // i2c-dev expects the extra byte count in buf[0], the driver appends the received length
+                read_msg->flags |= I2C_M_RECV_LEN;
+                read_msg->buf[0] = smbus_emul_has_pec(emul) ? 2 : 1;
+                read_msg->len = read_msg->buf[0] + SMBUS_BLOCK_MAX;
+            }
+            else
+            {
+                if(data->block[0] > SMBUS_BLOCK_MAX)
+                {
+                    errno = EINVAL;
+                    return -1;
+                }
+
+                write_msg->len = data->block[0] + 2;
+                memcpy(&write_msg->buf[1], data->block, data->block[0] + 1);
+            }
+            break;
+
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            if(data->block[0] > SMBUS_BLOCK_MAX)
+            {
+                errno = EINVAL;
+                return -1;
+            }
+
+            if(read_write == I2C_SMBUS_READ)
+            {
+                read_msg->len = data->block[0];
+            }
+            else
+            {
+                write_msg->len = data->block[0] + 1;
+                memcpy(&write_msg->buf[1], &data->block[1], data->block[0]);
+            }
+            break;
+
+        default:
+            errno = EOPNOTSUPP;
+            return -1;
+    }
+
+    if(smbus_emul_has_pec(emul))
+    {
+        struct i2c_msg* last_msg = &emul->msgs[emul->msg_count - 1];
+
+        if(last_msg->flags & I2C_M_RD)
+        {
+            if((last_msg->flags & I2C_M_RECV_LEN) == 0)
+            {
+                ++last_msg->len;
+            }
+        }
+        else
+        {
+            last_msg->buf[last_msg->len] = smbus_emul_msg_pec(0, last_msg, last_msg->len);
+            ++last_msg->len;
+        }
+    }
+
+    return emul->msg_count;
+}
+
+int smbus_emul_complete(
+    smbus_inst_t* smbus_inst,
+    smbus_emul_t* emul,
+    union i2c_smbus_data* data
+)
+{
+    // Only the tracepoint needs the handle
+    (void)smbus_inst;
+
+    struct i2c_msg* last_msg = &emul->msgs[emul->msg_count - 1];
+    uint16_t data_len = last_msg->len;
+
+    if(emul->read_write != I2C_SMBUS_READ || emul->command_type == I2C_SMBUS_QUICK)
+    {
+        return 0;
+    }
+
+    if(emul->command_type == I2C_SMBUS_BLOCK_DATA)
+    {
+        if(last_msg->buf[0] > SMBUS_BLOCK_MAX)
+        {
+            errno = EPROTO;
+            return -1;
+        }
+
+        data_len = last_msg->buf[0] + 1;
+    }
+    else if(smbus_emul_has_pec(emul))
+    {
+        --data_len;
+    }
+
+    if(smbus_emul_has_pec(emul))
+    {
+        uint8_t crc = 0;
+
+        if(emul->msg_count == 2)
+        {
+            crc = smbus_emul_msg_pec(crc, &emul->msgs[0], emul->msgs[0].len);
+        }
+
+        crc = smbus_emul_msg_pec(crc, last_msg, data_len);
+
+        if(crc != last_msg->buf[data_len])
+        {
+            SMBUS_TRACE_PEC_MISMATCH(smbus_inst->bus_index, last_msg->addr, emul->write_buf[0], last_msg->buf[data_len], crc);
+
+            errno = EBADMSG;
+            return -1;
+        }
+    }
+
+    switch(emul->command_type)
+    {
+        case I2C_SMBUS_BYTE:
+        case I2C_SMBUS_BYTE_DATA:
+            data->byte = last_msg->buf[0];
+            break;
+
+        case I2C_SMBUS_WORD_DATA:
+        case I2C_SMBUS_PROC_CALL:
+            data->word = last_msg->buf[0] | (last_msg->buf[1] << 8);
+            break;
+
+        case I2C_SMBUS_BLOCK_DATA:
+            memcpy(data->block, last_msg->buf, data_len);
+            break;
+
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            memcpy(&data->block[1], last_msg->buf, data_len);
+            break;
+    }
+
+    return 0;
+}
+
+int smbus_emul_batch(
+    smbus_inst_t* smbus_inst,
+    smbus_emul_t* emuls,
+    size_t emul_count
+)
+{
+    struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+    size_t emul_index = 0;
+
+    if((smbus_inst->func_flags & I2C_FUNC_I2C) == 0)
+    {
+        errno = EOPNOTSUPP;
+        return -1;
+    }
+
+    // Pack as many transfers as i2c-dev accepts into each I2C_RDWR submission
+    while(emul_index < emul_count)
+    {
+        unsigned msg_count = 0;
+
+        while(emul_index < emul_count && 
+            msg_count + emuls[emul_index].msg_count <= I2C_RDWR_IOCTL_MAX_MSGS)
+        {
+            memcpy(&msgs[msg_count], emuls[emul_index].msgs, emuls[emul_index].msg_count * sizeof(struct i2c_msg));
+            msg_count += emuls[emul_index].msg_count;
+            ++emul_index;
+        }
+
+        if(smbus_rdwr_submit(smbus_inst, msgs, msg_count, NULL) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int smbus_rdwr_submit(
+    smbus_inst_t* smbus_inst,
+    struct i2c_msg* msgs,
+    unsigned msg_count,
+    unsigned* done_count
+)
+{
+    bool is_mixed = false;
+    unsigned start = 0;
+    int res = 0;
+
+    if(done_count != NULL)
+    {
+        *done_count = 0;
+    }
+
+    for(unsigned i = 1; i < msg_count && !is_mixed; ++i)
+    {
+        is_mixed = (msgs[i].addr != msgs[0].addr);
+    }
+
+    if(!is_mixed || !smbus_inst->is_rdwr_split)
+    {
+        res = smbus_rdwr_ioctl(smbus_inst, msgs, msg_count);
+
+        if(res >= 0 && done_count != NULL)
+        {
+            *done_count = msg_count;
+        }
+
+        if(res >= 0 || !is_mixed || (errno != EINVAL && errno != EOPNOTSUPP))
+        {
+            return res;
+        }
+
+        // The i2c core refuses with EOPNOTSUPP before anything is sent. i2c-designware
+        // fails with EINVAL on the first address change, the run before it is already
+        // on the wire. Its writes are not sent again, but i2c-dev returns read data only
+        // from a successful submission, so a first run with reads is repeated.
+        if(errno == EINVAL)
+        {
+            bool has_read = false;
+
+            for(start = 0; start < msg_count && msgs[start].addr == msgs[0].addr; ++start)
+            {
+                has_read |= (msgs[start].flags & I2C_M_RD) != 0;
+            }
+
+            if(has_read)
+            {
+                start = 0;
+            }
+            else if(done_count != NULL)
+            {
+                *done_count = start;
+            }
+        }
+    }
+
+    while(start < msg_count)
+    {
+        unsigned end = start + 1;
+
+        while(end < msg_count && msgs[end].addr == msgs[start].addr)
+        {
+            ++end;
+        }
+
+        res = smbus_rdwr_ioctl(smbus_inst, &msgs[start], end - start);
+
+        // A run being refused as well means the messages themselves are wrong
+        if(res >= 0 || (errno != EINVAL && errno != EOPNOTSUPP))
+        {
+            smbus_inst->is_rdwr_split = true;
+        }
+
+        if(res < 0)
+        {
+            return -1;
+        }
+
+        start = end;
+
+        if(done_count != NULL)
+        {
+            *done_count = end;
+        }
+    }
+
+    return msg_count;
+}
+
+int smbus_rdwr_ioctl(
+    smbus_inst_t* smbus_inst,
+    struct i2c_msg* msgs,
+    unsigned msg_count
+)
+{
+    struct i2c_msg fixed_msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+    struct i2c_rdwr_ioctl_data rdwr = {
+        .msgs = msgs,
+        .nmsgs = msg_count,
+    };
+    bool has_recv_len = false;
+
+    for(unsigned i = 0; i < msg_count && msg_count <= I2C_RDWR_IOCTL_MAX_MSGS; ++i)
+    {
+        has_recv_len |= (msgs[i].flags & I2C_M_RECV_LEN) != 0;
+    }
+
+    for(bool is_fixed = has_recv_len && smbus_inst->is_recv_len_refused; ; is_fixed = true)
+    {
+        // Block reads take the whole buffer and read their count from buf[0] afterwards,
+        // the device sends idle bytes past its PEC
+        if(is_fixed)
+        {
+            memcpy(fixed_msgs, msgs, msg_count * sizeof(struct i2c_msg));
+
+            for(unsigned i = 0; i < msg_count; ++i)
+            {
+                fixed_msgs[i].flags &= ~I2C_M_RECV_LEN;
+            }
+
+            rdwr.msgs = fixed_msgs;
+        }
+
+        SMBUS_TRACE_BATCH_START(smbus_inst->bus_index, msg_count);
+
+        int res = smbus_ioctl(smbus_inst, I2C_RDWR, &rdwr);
+
+        SMBUS_TRACE_BATCH_END(smbus_inst->bus_index, msg_count, (res < 0) ? -errno : res);
+
+        // Adapters without I2C_M_RECV_LEN support refuse before anything is sent
+        if(res >= 0 || errno != EOPNOTSUPP || !has_recv_len || is_fixed)
+        {
+            if(is_fixed && (res >= 0 || errno != EOPNOTSUPP))
+            {
+                smbus_inst->is_recv_len_refused = true;
+            }
+
+            return res;
+        }
+    }
+}
+
+int smbus_emul_access(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t read_write,
+    uint8_t command,
+    union i2c_smbus_data* data
+)
+{
+    smbus_emul_t emul;
+    int res = 0;
+
+    if((res = smbus_emul_prepare(
+        &emul,
+        smbus_inst->slave_address,
+        smbus_inst->is_pec_enabled,
+        command_type,
+        read_write,
+        command,
+        data)) < 0)
+    {
+        return res;
+    }
+
+    if((res = smbus_emul_batch(smbus_inst, &emul, 1)) < 0)
+    {
+        return res;
+    }
+
+    return smbus_emul_complete(smbus_inst, &emul, data);
+}
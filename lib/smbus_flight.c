@@ -0,0 +1,362 @@
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+#define SMBUS_FLIGHT_SLOTS 16
+
+typedef enum smbus_flight_state_t
+{
+    SMBUS_FLIGHT_EMPTY,
+    SMBUS_FLIGHT_DONE,
+}
+smbus_flight_state_t;
+
+typedef struct smbus_flight_key_t
+{
+    unsigned command_type;
+    uint8_t address;
+    uint8_t command;
+    uint8_t length;
+    uint8_t is_pec_enabled;
+}
+smbus_flight_key_t;
+
+typedef struct smbus_flight_slot_t
+{
+    smbus_flight_state_t state;
+    smbus_flight_key_t key;
+    // Device was written since the read
+    bool is_stale;
+    uint64_t done_ns;
+    int res;
+    int error;
+    union i2c_smbus_data data;
+}
+smbus_flight_slot_t;
+
+struct smbus_flight_t
+{
+    pthread_mutex_t lock;
+    uint64_t freshness_ns;
+    smbus_flight_stats_t stats;
+    smbus_flight_slot_t slots[SMBUS_FLIGHT_SLOTS];
+};
+
+static uint64_t smbus_flight_now(void);
+
+static bool smbus_flight_is_shareable(
+    unsigned command_type,
+    uint8_t read_write
+);
+
+static void smbus_flight_make_key(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    smbus_flight_key_t* key
+);
+
+static void smbus_flight_invalidate(
+    smbus_flight_t* flight,
+    uint8_t address
+);
+
+static void smbus_flight_invalidate_msgs(
+    smbus_flight_t* flight,
+    struct i2c_rdwr_ioctl_data* rdwr
+);
+
+static int smbus_flight_result(
+    smbus_flight_slot_t* slot,
+    union i2c_smbus_data* data
+);
+
+bool smbus_set_single_flight(
+    smbus_handle_t smbus_handle,
+    bool is_enabled,
+    uint32_t freshness_us
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    if(!is_enabled)
+    {
+        smbus_flight_destroy(smbus_inst);
+        return true;
+    }
+
+    if(smbus_inst->flight == NULL)
+    {
+        smbus_flight_t* flight = calloc(1, sizeof(smbus_flight_t));
+
+        if(flight == NULL)
+        {
+            return false;
+        }
+
+        pthread_mutex_init(&flight->lock, NULL);
+        smbus_inst->flight = flight;
+    }
+
+    pthread_mutex_lock(&smbus_inst->flight->lock);
+    smbus_inst->flight->freshness_ns = (uint64_t)freshness_us * 1000;
+    pthread_mutex_unlock(&smbus_inst->flight->lock);
+
+    return true;
+}
+
+bool smbus_get_single_flight_stats(
+    smbus_handle_t smbus_handle,
+    smbus_flight_stats_t* stats
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    if(smbus_inst->flight == NULL)
+    {
+        memset(stats, 0, sizeof(smbus_flight_stats_t));
+        return true;
+    }
+
+    pthread_mutex_lock(&smbus_inst->flight->lock);
+    *stats = smbus_inst->flight->stats;
+    pthread_mutex_unlock(&smbus_inst->flight->lock);
+
+    return true;
+}
+
+void smbus_flight_destroy(
+    smbus_inst_t* smbus_inst
+)
+{
+    smbus_flight_t* flight = smbus_inst->flight;
+
+    if(flight == NULL)
+    {
+        return;
+    }
+
+    smbus_inst->flight = NULL;
+
+    pthread_mutex_destroy(&flight->lock);
+    free(flight);
+}
+
+uint64_t smbus_flight_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+bool smbus_flight_is_shareable(
+    unsigned command_type,
+    uint8_t read_write
+)
+{
+    if(read_write != I2C_SMBUS_READ)
+    {
+        return false;
+    }
+
+    switch(command_type)
+    {
+        case I2C_SMBUS_BYTE:
+        case I2C_SMBUS_BYTE_DATA:
+        case I2C_SMBUS_WORD_DATA:
+        case I2C_SMBUS_BLOCK_DATA:
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            return true;
+    }
+
+    return false;
+}
+
+void smbus_flight_make_key(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    smbus_flight_key_t* key
+)
+{
+    memset(key, 0, sizeof(smbus_flight_key_t));
+
+    key->command_type = command_type;
+    key->address = smbus_inst->slave_address;
+    key->command = command;
+    key->is_pec_enabled = smbus_inst->is_pec_enabled;
+
+    // I2C block reads carry the requested length as input
+    if(command_type == I2C_SMBUS_I2C_BLOCK_DATA)
+    {
+        key->length = data->block[0];
+    }
+}
+
+void smbus_flight_invalidate(
+    smbus_flight_t* flight,
+    uint8_t address
+)
+{
+    for(size_t i = 0; i < SMBUS_FLIGHT_SLOTS; ++i)
+    {
+        smbus_flight_slot_t* slot = &flight->slots[i];
+
+        if(slot->state != SMBUS_FLIGHT_EMPTY && slot->key.address == address)
+        {
+            slot->is_stale = true;
+        }
+    }
+}
+
+void smbus_flight_invalidate_msgs(
+    smbus_flight_t* flight,
+    struct i2c_rdwr_ioctl_data* rdwr
+)
+{
+    for(unsigned i = 0; i < rdwr->nmsgs; ++i)
+    {
+        struct i2c_msg* msg = &rdwr->msgs[i];
+        struct i2c_msg* next = (i + 1 < rdwr->nmsgs) ? &rdwr->msgs[i + 1] : NULL;
+
+        if(msg->flags & I2C_M_RD)
+        {
+            continue;
+        }
+
+        // A lone command byte ahead of a read of the same device only selects the register
+        bool is_command = msg->len == 1 && next != NULL &&
+            (next->flags & I2C_M_RD) && next->addr == msg->addr;
+
+        if(!is_command)
+        {
+            smbus_flight_invalidate(flight, msg->addr);
+        }
+    }
+}
+
+void smbus_flight_written(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+)
+{
+    smbus_flight_t* flight = smbus_inst->flight;
+
+    if(flight == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&flight->lock);
+
+    if(request == I2C_RDWR)
+    {
+        smbus_flight_invalidate_msgs(flight, (struct i2c_rdwr_ioctl_data*)arg);
+    }
+    else if(request == I2C_SMBUS)
+    {
+        struct i2c_smbus_ioctl_data* args = (struct i2c_smbus_ioctl_data*)arg;
+
+        if(!smbus_flight_is_shareable(args->size, args->read_write))
+        {
+            smbus_flight_invalidate(flight, smbus_inst->slave_address);
+        }
+    }
+
+    pthread_mutex_unlock(&flight->lock);
+}
+
+int smbus_flight_result(
+    smbus_flight_slot_t* slot,
+    union i2c_smbus_data* data
+)
+{
+    if(slot->res < 0)
+    {
+        errno = slot->error;
+        return slot->res;
+    }
+
+    memcpy(data, &slot->data, sizeof(union i2c_smbus_data));
+
+    return slot->res;
+}
+
+int smbus_flight_access(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t read_write,
+    uint8_t command,
+    union i2c_smbus_data* data
+)
+{
+    smbus_flight_t* flight = smbus_inst->flight;
+    // A result completed after the request arrived is as fresh as a read of its own
+    uint64_t request_ns = smbus_flight_now();
+    smbus_flight_key_t key;
+    int res = 0;
+
+    // Writes mark the cache stale in smbus_ioctl, whichever path sent them
+    if(!smbus_flight_is_shareable(command_type, read_write))
+    {
+        return smbus_bus_access(smbus_inst, command_type, read_write, command, data);
+    }
+
+    // Identical reads queue on the handle lock, the first one reads and those behind it
+    // take its result. The lock also keeps the slave address of the key.
+    smbus_inst_lock(smbus_inst);
+
+    smbus_flight_make_key(smbus_inst, command_type, command, data, &key);
+
+    smbus_flight_slot_t* slot = &flight->slots[(key.address * 31u + key.command) % SMBUS_FLIGHT_SLOTS];
+
+    pthread_mutex_lock(&flight->lock);
+
+    bool is_fresh = slot->state == SMBUS_FLIGHT_DONE && !slot->is_stale && slot->res >= 0 &&
+        memcmp(&slot->key, &key, sizeof(key)) == 0 &&
+        (slot->done_ns >= request_ns || smbus_flight_now() - slot->done_ns <= flight->freshness_ns);
+
+    if(is_fresh)
+    {
+        ++flight->stats.shared;
+        res = smbus_flight_result(slot, data);
+
+        pthread_mutex_unlock(&flight->lock);
+        smbus_inst_unlock(smbus_inst);
+
+        return res;
+    }
+
+    ++flight->stats.issued;
+
+    pthread_mutex_unlock(&flight->lock);
+
+    res = smbus_bus_access(smbus_inst, command_type, read_write, command, data);
+    int error = errno;
+
+    pthread_mutex_lock(&flight->lock);
+
+    slot->state = SMBUS_FLIGHT_DONE;
+    slot->key = key;
+    slot->is_stale = false;
+    slot->done_ns = smbus_flight_now();
+    slot->res = res;
+    slot->error = error;
+    memcpy(&slot->data, data, sizeof(union i2c_smbus_data));
+
+    pthread_mutex_unlock(&flight->lock);
+    smbus_inst_unlock(smbus_inst);
+
+    errno = error;
+
+    return res;
+}
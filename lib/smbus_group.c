@@ -0,0 +1,404 @@
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <smbus_pec.h>
+#include <string.h>
+#include <errno.h>
+
+// Command, block length and block data
+#define SMBUS_GROUP_PAYLOAD_MAX (SMBUS_BLOCK_MAX + 2)
+
+typedef struct smbus_group_pec_t
+{
+    // PEC of the payload alone
+    uint8_t payload_crc;
+    // Contribution of each CRC state bit carried through the payload
+    uint8_t basis[8];
+}
+smbus_group_pec_t;
+
+static void smbus_group_pec_prepare(
+    smbus_group_pec_t* group_pec,
+    uint8_t* payload,
+    size_t payload_len
+);
+
+static uint8_t smbus_group_pec(
+    const smbus_group_pec_t* group_pec,
+    uint8_t address
+);
+
+static size_t smbus_group_payload(
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    uint8_t* payload
+);
+
+static bool smbus_group_write(
+    smbus_inst_t* smbus_inst,
+    const uint8_t* addresses,
+    size_t address_count,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    int* status
+);
+
+static bool smbus_group_write_single(
+    smbus_inst_t* smbus_inst,
+    const uint8_t* addresses,
+    size_t address_count,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    int* status
+);
+
+static bool smbus_broadcast_write(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data
+);
+
+bool smbus_group_write_byte_data(
+    smbus_handle_t smbus_handle,
+    const uint8_t* addresses,
+    size_t address_count,
+    uint8_t command,
+    uint8_t byte,
+    int* status
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    union i2c_smbus_data data;
+
+    data.byte = byte;
+
+    return smbus_group_write(smbus_inst, addresses, address_count, I2C_SMBUS_BYTE_DATA, command, &data, status);
+}
+
+bool smbus_group_write_word_data(
+    smbus_handle_t smbus_handle,
+    const uint8_t* addresses,
+    size_t address_count,
+    uint8_t command,
+    uint16_t word,
+    int* status
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    union i2c_smbus_data data;
+
+    data.word = word;
+
+    return smbus_group_write(smbus_inst, addresses, address_count, I2C_SMBUS_WORD_DATA, command, &data, status);
+}
+
+bool smbus_group_write_block_data(
+    smbus_handle_t smbus_handle,
+    const uint8_t* addresses,
+    size_t address_count,
+    uint8_t command,
+    const uint8_t* block,
+    uint8_t length,
+    int* status
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    union i2c_smbus_data data;
+
+    if(length > SMBUS_BLOCK_MAX)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    data.block[0] = length;
+    memcpy(&data.block[1], block, length);
+
+    return smbus_group_write(smbus_inst, addresses, address_count, I2C_SMBUS_BLOCK_DATA, command, &data, status);
+}
+
+bool smbus_broadcast_write_byte_data(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint8_t byte
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    union i2c_smbus_data data;
+
+    data.byte = byte;
+
+    return smbus_broadcast_write(smbus_inst, I2C_SMBUS_BYTE_DATA, command, &data);
+}
+
+bool smbus_broadcast_write_word_data(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint16_t word
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    union i2c_smbus_data data;
+
+    data.word = word;
+
+    return smbus_broadcast_write(smbus_inst, I2C_SMBUS_WORD_DATA, command, &data);
+}
+
+void smbus_group_pec_prepare(
+    smbus_group_pec_t* group_pec,
+    uint8_t* payload,
+    size_t payload_len
+)
+{
+    // CRC-8 without init and final XOR is linear, so PEC(address + payload) is
+    // PEC(payload) XOR the address CRC state carried through payload_len zero bytes
+    group_pec->payload_crc = smbus_pec_block(0, payload, payload_len);
+
+    for(unsigned bit = 0; bit < 8; ++bit)
+    {
+        uint8_t crc = 1 << bit;
+
+        for(size_t i = 0; i < payload_len; ++i)
+        {
+            crc = smbus_pec_single(crc, 0);
+        }
+
+        group_pec->basis[bit] = crc;
+    }
+}
+
+uint8_t smbus_group_pec(
+    const smbus_group_pec_t* group_pec,
+    uint8_t address
+)
+{
+    uint8_t state = smbus_pec_single(0, address << 1);
+    uint8_t crc = group_pec->payload_crc;
+
+    for(unsigned bit = 0; bit < 8; ++bit)
+    {
+        if(state & (1 << bit))
+        {
+            crc ^= group_pec->basis[bit];
+        }
+    }
+
+    return crc;
+}
+
+size_t smbus_group_payload(
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    uint8_t* payload
+)
+{
+    payload[0] = command;
+
+    switch(command_type)
+    {
+        case I2C_SMBUS_BYTE_DATA:
+            payload[1] = data->byte;
+            return 2;
+
+        case I2C_SMBUS_WORD_DATA:
+            payload[1] = data->word & 0xFF;
+            payload[2] = data->word >> 8;
+            return 3;
+
+        case I2C_SMBUS_BLOCK_DATA:
+            memcpy(&payload[1], data->block, data->block[0] + 1);
+            return data->block[0] + 2;
+    }
+
+    return 0;
+}
+
+bool smbus_group_write(
+    smbus_inst_t* smbus_inst,
+    const uint8_t* addresses,
+    size_t address_count,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    int* status
+)
+{
+    uint8_t payload[SMBUS_GROUP_PAYLOAD_MAX];
+    // Messages carrying a PEC byte need a buffer of their own
+    uint8_t pec_bufs[I2C_RDWR_IOCTL_MAX_MSGS][SMBUS_GROUP_PAYLOAD_MAX + 1];
+    struct i2c_msg msgs[I2C_RDWR_IOCTL_MAX_MSGS];
+    smbus_group_pec_t group_pec;
+    int error = 0;
+
+    if(address_count != 0 && addresses == NULL)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    if(!smbus_lock(smbus_inst))
+    {
+        return false;
+    }
+
+    if((smbus_inst->func_flags & I2C_FUNC_I2C) == 0)
+    {
+        bool res = smbus_group_write_single(smbus_inst, addresses, address_count, command_type, command, data, status);
+        smbus_unlock(smbus_inst);
+
+        return res;
+    }
+
+    size_t payload_len = smbus_group_payload(command_type, command, data, payload);
+    memset(&group_pec, 0, sizeof(smbus_group_pec_t));
+
+    if(smbus_inst->is_pec_enabled)
+    {
+        smbus_group_pec_prepare(&group_pec, payload, payload_len);
+    }
+
+    for(size_t chunk = 0; chunk < address_count; chunk += I2C_RDWR_IOCTL_MAX_MSGS)
+    {
+        unsigned msg_count = 0;
+
+        for(size_t i = chunk; i < address_count && msg_count < I2C_RDWR_IOCTL_MAX_MSGS; ++i)
+        {
+            struct i2c_msg* msg = &msgs[msg_count];
+
+            msg->addr = addresses[i];
+            msg->flags = 0;
+            msg->len = payload_len;
+            msg->buf = payload;
+
+            if(smbus_inst->is_pec_enabled)
+            {
+                msg->buf = pec_bufs[msg_count];
+                memcpy(msg->buf, payload, payload_len);
+                msg->buf[msg->len++] = smbus_group_pec(&group_pec, addresses[i]);
+            }
+
+            ++msg_count;
+        }
+
+        unsigned done_count = 0;
+
+        if(smbus_rdwr_submit(smbus_inst, msgs, msg_count, &done_count) >= 0)
+        {
+            if(status != NULL)
+            {
+                memset(&status[chunk], 0, msg_count * sizeof(int));
+            }
+
+            continue;
+        }
+
+        // The adapter stops at the first NACK without telling which device it was,
+        // so each device not known to be written is written again on its own
+        for(unsigned i = 0; i < msg_count; ++i)
+        {
+            int res = (i < done_count) ? 0 : smbus_rdwr_submit(smbus_inst, &msgs[i], 1, NULL);
+
+            if(res < 0 && error == 0)
+            {
+                error = errno;
+            }
+
+            if(status != NULL)
+            {
+                status[chunk + i] = (res < 0) ? -errno : 0;
+            }
+        }
+    }
+
+    smbus_unlock(smbus_inst);
+
+    errno = error;
+
+    return (error == 0);
+}
+
+bool smbus_group_write_single(
+    smbus_inst_t* smbus_inst,
+    const uint8_t* addresses,
+    size_t address_count,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data,
+    int* status
+)
+{
+    uint8_t slave_address = smbus_inst->slave_address;
+    int error = 0;
+
+    for(size_t i = 0; i < address_count; ++i)
+    {
+        union i2c_smbus_data copy;
+        int res = -1;
+
+        memcpy(&copy, data, sizeof(union i2c_smbus_data));
+
+        if(smbus_use_slave(smbus_inst, addresses[i]))
+        {
+            res = smbus_bus_access(smbus_inst, command_type, I2C_SMBUS_WRITE, command, &copy);
+        }
+
+        if(res < 0 && error == 0)
+        {
+            error = errno;
+        }
+
+        if(status != NULL)
+        {
+            status[i] = (res < 0) ? -errno : 0;
+        }
+    }
+
+    if(smbus_inst->slave_address != slave_address && !smbus_use_slave(smbus_inst, slave_address) && error == 0)
+    {
+        error = errno;
+    }
+
+    errno = error;
+
+    return (error == 0);
+}
+
+bool smbus_broadcast_write(
+    smbus_inst_t* smbus_inst,
+    unsigned command_type,
+    uint8_t command,
+    union i2c_smbus_data* data
+)
+{
+    uint8_t payload[SMBUS_GROUP_PAYLOAD_MAX];
+
+    // Several devices answer a general call at once, PEC is never appended
+    if((smbus_inst->func_flags & I2C_FUNC_I2C) == 0)
+    {
+        errno = EOPNOTSUPP;
+        return false;
+    }
+
+    struct i2c_msg msg = {
+        .addr = SMBUS_GENERAL_CALL_ADDRESS,
+        .flags = 0,
+        .len = smbus_group_payload(command_type, command, data, payload),
+        .buf = payload,
+    };
+
+    smbus_inst_lock(smbus_inst);
+    int res = smbus_rdwr_submit(smbus_inst, &msg, 1, NULL);
+    smbus_inst_unlock(smbus_inst);
+
+    return (res >= 0);
+}
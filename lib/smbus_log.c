@@ -0,0 +1,690 @@
+#define _GNU_SOURCE
+#include <smbus/smbus_log.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define SMBUS_LOG_HANDLE_CHECK(log_handle)  \
+    {                                       \
+        if(log_handle == NULL)              \
+        {                                   \
+            errno = EINVAL;                 \
+            return false;                   \
+        }                                   \
+    }                                       \
+    while(0)
+
+// "SMBL"
+#define SMBUS_LOG_MAGIC 0x4C424D53
+#define SMBUS_LOG_VERSION 1
+#define SMBUS_LOG_VARINT_MAX 10
+// Timestamp and value varints
+#define SMBUS_LOG_SAMPLE_MAX (2 * SMBUS_LOG_VARINT_MAX)
+
+typedef enum smbus_log_block_kind_t
+{
+    SMBUS_LOG_BLOCK_SERIES = 1,
+    SMBUS_LOG_BLOCK_DATA = 2,
+}
+smbus_log_block_kind_t;
+
+typedef struct smbus_log_block_header_t
+{
+    uint32_t magic;
+    uint8_t kind;
+    uint8_t version;
+    uint16_t series;
+    // Samples or series descriptors in the block
+    uint16_t count;
+    uint16_t length;
+    uint32_t reserved;
+    uint64_t first_timestamp_ns;
+    uint64_t first_value;
+}
+smbus_log_block_header_t;
+
+#define SMBUS_LOG_PAYLOAD_MAX (SMBUS_LOG_BLOCK_SIZE - sizeof(smbus_log_block_header_t))
+#define SMBUS_LOG_SERIES_PER_BLOCK (SMBUS_LOG_PAYLOAD_MAX / sizeof(smbus_log_series_t))
+
+typedef struct smbus_log_encoder_t
+{
+    smbus_log_series_t desc;
+    // Block under construction, aligned for O_DIRECT
+    uint8_t* block;
+    uint64_t prev_timestamp_ns;
+    int64_t prev_delta_ns;
+    uint64_t prev_value;
+}
+smbus_log_encoder_t;
+
+typedef struct smbus_log_inst_t
+{
+    int fd;
+    pthread_mutex_t lock;
+    uint16_t series_count;
+    uint16_t series_written;
+    smbus_log_stats_t stats;
+    smbus_log_encoder_t encoders[SMBUS_LOG_SERIES_MAX];
+}
+smbus_log_inst_t;
+
+typedef struct smbus_log_reader_inst_t
+{
+    int fd;
+    uint8_t block[SMBUS_LOG_BLOCK_SIZE];
+    // Position inside the current data block
+    size_t offset;
+    uint16_t remaining;
+    uint64_t prev_timestamp_ns;
+    int64_t prev_delta_ns;
+    uint64_t prev_value;
+    bool is_known[SMBUS_LOG_SERIES_MAX];
+    smbus_log_series_t series[SMBUS_LOG_SERIES_MAX];
+}
+smbus_log_reader_inst_t;
+
+static uint64_t smbus_log_now(
+    clockid_t clock_id
+);
+
+static size_t smbus_log_put_varint(
+    uint8_t* buf,
+    int64_t value
+);
+
+static bool smbus_log_get_varint(
+    const uint8_t* buf,
+    size_t length,
+    size_t* offset,
+    int64_t* value
+);
+
+static bool smbus_log_write_block(
+    smbus_log_inst_t* log_inst,
+    const void* block
+);
+
+static bool smbus_log_write_series(
+    smbus_log_inst_t* log_inst
+);
+
+static bool smbus_log_flush_encoder(
+    smbus_log_inst_t* log_inst,
+    smbus_log_encoder_t* encoder
+);
+
+static bool smbus_log_read_block(
+    smbus_log_reader_inst_t* reader_inst
+);
+
+uint64_t smbus_log_now(
+    clockid_t clock_id
+)
+{
+    struct timespec now;
+    clock_gettime(clock_id, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+size_t smbus_log_put_varint(
+    uint8_t* buf,
+    int64_t value
+)
+{
+    // Zigzag keeps small negative deltas short
+    uint64_t zigzag = ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+    size_t length = 0;
+
+    while(zigzag >= 0x80)
+    {
+        buf[length++] = (uint8_t)zigzag | 0x80;
+        zigzag >>= 7;
+    }
+
+    buf[length++] = (uint8_t)zigzag;
+
+    return length;
+}
+
+bool smbus_log_get_varint(
+    const uint8_t* buf,
+    size_t length,
+    size_t* offset,
+    int64_t* value
+)
+{
+    uint64_t zigzag = 0;
+
+    for(unsigned shift = 0; shift < 64 && *offset < length; shift += 7)
+    {
+        uint8_t byte = buf[(*offset)++];
+        zigzag |= (uint64_t)(byte & 0x7F) << shift;
+
+        if((byte & 0x80) == 0)
+        {
+            *value = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+smbus_log_handle_t smbus_log_open(
+    const char* path
+)
+{
+    smbus_log_inst_t* log_inst = calloc(1, sizeof(smbus_log_inst_t));
+
+    if(log_inst == NULL)
+    {
+        return NULL;
+    }
+
+    log_inst->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+
+    // tmpfs and some FUSE filesystems reject O_DIRECT
+    if(log_inst->fd < 0 && errno == EINVAL)
+    {
+        log_inst->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    }
+
+    if(log_inst->fd < 0)
+    {
+        free(log_inst);
+        return NULL;
+    }
+
+    pthread_mutex_init(&log_inst->lock, NULL);
+
+    return log_inst;
+}
+
+bool smbus_log_close(
+    smbus_log_handle_t log_handle
+)
+{
+    SMBUS_LOG_HANDLE_CHECK(log_handle);
+    smbus_log_inst_t* log_inst = (smbus_log_inst_t*)log_handle;
+
+    bool res = smbus_log_flush(log_handle);
+
+    for(uint16_t i = 0; i < log_inst->series_count; ++i)
+    {
+        free(log_inst->encoders[i].block);
+    }
+
+    if(close(log_inst->fd) < 0)
+    {
+        res = false;
+    }
+
+    pthread_mutex_destroy(&log_inst->lock);
+    free(log_inst);
+
+    return res;
+}
+
+int smbus_log_add_series(
+    smbus_log_handle_t log_handle,
+    const char* name,
+    uint8_t address,
+    uint8_t command,
+    smbus_reg_type_t type
+)
+{
+    smbus_log_inst_t* log_inst = (smbus_log_inst_t*)log_handle;
+    void* block = NULL;
+
+    if(log_inst == NULL || type == SMBUS_REG_BLOCK)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+
+    if(posix_memalign(&block, SMBUS_LOG_BLOCK_SIZE, SMBUS_LOG_BLOCK_SIZE) != 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    memset(block, 0, SMBUS_LOG_BLOCK_SIZE);
+
+    pthread_mutex_lock(&log_inst->lock);
+
+    if(log_inst->series_count == SMBUS_LOG_SERIES_MAX)
+    {
+        pthread_mutex_unlock(&log_inst->lock);
+        free(block);
+
+        errno = ENOSPC;
+        return -1;
+    }
+
+    uint16_t id = log_inst->series_count++;
+    smbus_log_encoder_t* encoder = &log_inst->encoders[id];
+
+    memset(encoder, 0, sizeof(smbus_log_encoder_t));
+    encoder->block = block;
+    encoder->desc.id = id;
+    encoder->desc.address = address;
+    encoder->desc.command = command;
+    encoder->desc.type = type;
+    snprintf(encoder->desc.name, SMBUS_LOG_NAME_MAX, "%s", (name != NULL) ? name : "");
+
+    pthread_mutex_unlock(&log_inst->lock);
+
+    return id;
+}
+
+bool smbus_log_append(
+    smbus_log_handle_t log_handle,
+    uint16_t series,
+    uint64_t timestamp_ns,
+    uint64_t value
+)
+{
+    SMBUS_LOG_HANDLE_CHECK(log_handle);
+    smbus_log_inst_t* log_inst = (smbus_log_inst_t*)log_handle;
+    bool res = true;
+
+    pthread_mutex_lock(&log_inst->lock);
+
+    if(series >= log_inst->series_count)
+    {
+        pthread_mutex_unlock(&log_inst->lock);
+
+        errno = EINVAL;
+        return false;
+    }
+
+    smbus_log_encoder_t* encoder = &log_inst->encoders[series];
+    smbus_log_block_header_t* header = (smbus_log_block_header_t*)encoder->block;
+    uint8_t* payload = encoder->block + sizeof(smbus_log_block_header_t);
+
+    if(header->count != 0 && (size_t)header->length + SMBUS_LOG_SAMPLE_MAX > SMBUS_LOG_PAYLOAD_MAX)
+    {
+        res = smbus_log_flush_encoder(log_inst, encoder);
+    }
+
+    if(header->count == 0)
+    {
+        header->first_timestamp_ns = timestamp_ns;
+        header->first_value = value;
+        encoder->prev_delta_ns = 0;
+    }
+    else
+    {
+        int64_t delta_ns = (int64_t)(timestamp_ns - encoder->prev_timestamp_ns);
+
+        header->length += smbus_log_put_varint(&payload[header->length], delta_ns - encoder->prev_delta_ns);
+        header->length += smbus_log_put_varint(&payload[header->length], (int64_t)(value - encoder->prev_value));
+
+        encoder->prev_delta_ns = delta_ns;
+    }
+
+    encoder->prev_timestamp_ns = timestamp_ns;
+    encoder->prev_value = value;
+    ++header->count;
+    ++log_inst->stats.samples;
+
+    pthread_mutex_unlock(&log_inst->lock);
+
+    return res;
+}
+
+bool smbus_log_sample(
+    smbus_log_handle_t log_handle,
+    uint16_t series,
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_LOG_HANDLE_CHECK(log_handle);
+    smbus_log_inst_t* log_inst = (smbus_log_inst_t*)log_handle;
+    uint64_t value = 0;
+    bool res = false;
+
+    // Descriptors never change once added
+    if(series >= log_inst->series_count)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    const smbus_log_series_t* desc = &log_inst->encoders[series].desc;
+
+    if(!smbus_lock(smbus_handle))
+    {
+        return false;
+    }
+
+    uint64_t timestamp_ns = smbus_log_now(CLOCK_REALTIME);
+
+    if(smbus_get_slave(smbus_handle) == desc->address || smbus_use_slave(smbus_handle, desc->address))
+    {
+        switch(desc->type)
+        {
+            case SMBUS_REG_BYTE:
+            {
+                uint8_t byte = 0;
+                res = smbus_reg_read_BYTE(smbus_handle, desc->command, &byte);
+                value = byte;
+                break;
+            }
+            case SMBUS_REG_WORD:
+            {
+                uint16_t word = 0;
+                res = smbus_reg_read_WORD(smbus_handle, desc->command, &word);
+                value = word;
+                break;
+            }
+            case SMBUS_REG_DWORD:
+            {
+                uint32_t dword = 0;
+                res = smbus_reg_read_DWORD(smbus_handle, desc->command, &dword);
+                value = dword;
+                break;
+            }
+            case SMBUS_REG_QWORD:
+                res = smbus_reg_read_QWORD(smbus_handle, desc->command, &value);
+                break;
+        }
+    }
+
+    smbus_unlock(smbus_handle);
+
+    if(!res)
+    {
+        return false;
+    }
+
+    return smbus_log_append(log_handle, series, timestamp_ns, value);
+}
+
+bool smbus_log_flush(
+    smbus_log_handle_t log_handle
+)
+{
+    SMBUS_LOG_HANDLE_CHECK(log_handle);
+    smbus_log_inst_t* log_inst = (smbus_log_inst_t*)log_handle;
+    bool res = true;
+
+    pthread_mutex_lock(&log_inst->lock);
+
+    for(uint16_t i = 0; i < log_inst->series_count && res; ++i)
+    {
+        smbus_log_encoder_t* encoder = &log_inst->encoders[i];
+
+        if(((smbus_log_block_header_t*)encoder->block)->count != 0)
+        {
+            res = smbus_log_flush_encoder(log_inst, encoder);
+        }
+    }
+
+    pthread_mutex_unlock(&log_inst->lock);
+
+    return res;
+}
+
+bool smbus_log_get_stats(
+    smbus_log_handle_t log_handle,
+    smbus_log_stats_t* stats
+)
+{
+    SMBUS_LOG_HANDLE_CHECK(log_handle);
+    smbus_log_inst_t* log_inst = (smbus_log_inst_t*)log_handle;
+
+    pthread_mutex_lock(&log_inst->lock);
+    *stats = log_inst->stats;
+    pthread_mutex_unlock(&log_inst->lock);
+
+    return true;
+}
+
+bool smbus_log_write_block(
+    smbus_log_inst_t* log_inst,
+    const void* block
+)
+{
+    uint64_t start_ns = smbus_log_now(CLOCK_MONOTONIC);
+    ssize_t res = write(log_inst->fd, block, SMBUS_LOG_BLOCK_SIZE);
+
+    log_inst->stats.write_ns += smbus_log_now(CLOCK_MONOTONIC) - start_ns;
+
+    if(res != SMBUS_LOG_BLOCK_SIZE)
+    {
+        if(res >= 0)
+        {
+            errno = EIO;
+        }
+
+        return false;
+    }
+
+    ++log_inst->stats.blocks;
+    log_inst->stats.bytes_written += SMBUS_LOG_BLOCK_SIZE;
+
+    return true;
+}
+
+bool smbus_log_write_series(
+    smbus_log_inst_t* log_inst
+)
+{
+    uint8_t* block = NULL;
+    bool res = true;
+
+    if(posix_memalign((void**)&block, SMBUS_LOG_BLOCK_SIZE, SMBUS_LOG_BLOCK_SIZE) != 0)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    while(res && log_inst->series_written < log_inst->series_count)
+    {
+        smbus_log_block_header_t* header = (smbus_log_block_header_t*)block;
+        smbus_log_series_t* descs = (smbus_log_series_t*)(block + sizeof(smbus_log_block_header_t));
+
+        memset(block, 0, SMBUS_LOG_BLOCK_SIZE);
+        header->magic = SMBUS_LOG_MAGIC;
+        header->kind = SMBUS_LOG_BLOCK_SERIES;
+        header->version = SMBUS_LOG_VERSION;
+
+        while(header->count < SMBUS_LOG_SERIES_PER_BLOCK && log_inst->series_written < log_inst->series_count)
+        {
+            descs[header->count++] = log_inst->encoders[log_inst->series_written++].desc;
+        }
+
+        header->length = header->count * sizeof(smbus_log_series_t);
+        res = smbus_log_write_block(log_inst, block);
+    }
+
+    free(block);
+
+    return res;
+}
+
+bool smbus_log_flush_encoder(
+    smbus_log_inst_t* log_inst,
+    smbus_log_encoder_t* encoder
+)
+{
+    smbus_log_block_header_t* header = (smbus_log_block_header_t*)encoder->block;
+    bool res = true;
+
+    // Readers must know a series before its first data block
+    if(log_inst->series_written < log_inst->series_count)
+    {
+        res = smbus_log_write_series(log_inst);
+    }
+
+    if(res)
+    {
+        header->magic = SMBUS_LOG_MAGIC;
+        header->kind = SMBUS_LOG_BLOCK_DATA;
+        header->version = SMBUS_LOG_VERSION;
+        header->series = encoder->desc.id;
+
+        res = smbus_log_write_block(log_inst, encoder->block);
+        log_inst->stats.payload_bytes += header->length;
+    }
+
+    // The block is dropped on error as well, the next one starts over
+    memset(encoder->block, 0, SMBUS_LOG_BLOCK_SIZE);
+
+    return res;
+}
+
+smbus_log_reader_t smbus_log_reader_open(
+    const char* path
+)
+{
+    smbus_log_reader_inst_t* reader_inst = calloc(1, sizeof(smbus_log_reader_inst_t));
+
+    if(reader_inst == NULL)
+    {
+        return NULL;
+    }
+
+    reader_inst->fd = open(path, O_RDONLY);
+
+    if(reader_inst->fd < 0)
+    {
+        free(reader_inst);
+        return NULL;
+    }
+
+    return reader_inst;
+}
+
+bool smbus_log_reader_close(
+    smbus_log_reader_t log_reader
+)
+{
+    SMBUS_LOG_HANDLE_CHECK(log_reader);
+    smbus_log_reader_inst_t* reader_inst = (smbus_log_reader_inst_t*)log_reader;
+
+    int res = close(reader_inst->fd);
+    free(reader_inst);
+
+    return (res == 0);
+}
+
+bool smbus_log_read_block(
+    smbus_log_reader_inst_t* reader_inst
+)
+{
+    smbus_log_block_header_t* header = (smbus_log_block_header_t*)reader_inst->block;
+
+    for(;;)
+    {
+        ssize_t res = read(reader_inst->fd, reader_inst->block, SMBUS_LOG_BLOCK_SIZE);
+
+        if(res == 0)
+        {
+            errno = 0;
+            return false;
+        }
+
+        if(res != SMBUS_LOG_BLOCK_SIZE || header->magic != SMBUS_LOG_MAGIC ||
+            header->version != SMBUS_LOG_VERSION || header->length > SMBUS_LOG_PAYLOAD_MAX)
+        {
+            errno = (res < 0) ? errno : EBADMSG;
+            return false;
+        }
+
+        if(header->kind == SMBUS_LOG_BLOCK_SERIES)
+        {
+            const smbus_log_series_t* descs = (const smbus_log_series_t*)(reader_inst->block + sizeof(smbus_log_block_header_t));
+
+            for(uint16_t i = 0; i < header->count && i < SMBUS_LOG_SERIES_PER_BLOCK; ++i)
+            {
+                if(descs[i].id < SMBUS_LOG_SERIES_MAX)
+                {
+                    reader_inst->series[descs[i].id] = descs[i];
+                    reader_inst->is_known[descs[i].id] = true;
+                }
+            }
+
+            continue;
+        }
+
+        if(header->kind == SMBUS_LOG_BLOCK_DATA && header->count != 0)
+        {
+            reader_inst->offset = 0;
+            reader_inst->remaining = header->count;
+
+            return true;
+        }
+    }
+}
+
+bool smbus_log_reader_next(
+    smbus_log_reader_t log_reader,
+    smbus_log_sample_t* sample
+)
+{
+    SMBUS_LOG_HANDLE_CHECK(log_reader);
+    smbus_log_reader_inst_t* reader_inst = (smbus_log_reader_inst_t*)log_reader;
+    smbus_log_block_header_t* header = (smbus_log_block_header_t*)reader_inst->block;
+    const uint8_t* payload = reader_inst->block + sizeof(smbus_log_block_header_t);
+
+    if(reader_inst->remaining == 0 && !smbus_log_read_block(reader_inst))
+    {
+        return false;
+    }
+
+    if(reader_inst->remaining == header->count)
+    {
+        reader_inst->prev_timestamp_ns = header->first_timestamp_ns;
+        reader_inst->prev_delta_ns = 0;
+        reader_inst->prev_value = header->first_value;
+    }
+    else
+    {
+        int64_t delta_of_delta = 0;
+        int64_t value_delta = 0;
+
+        if(!smbus_log_get_varint(payload, header->length, &reader_inst->offset, &delta_of_delta) ||
+            !smbus_log_get_varint(payload, header->length, &reader_inst->offset, &value_delta))
+        {
+            reader_inst->remaining = 0;
+
+            errno = EBADMSG;
+            return false;
+        }
+
+        reader_inst->prev_delta_ns += delta_of_delta;
+        reader_inst->prev_timestamp_ns += reader_inst->prev_delta_ns;
+        reader_inst->prev_value += value_delta;
+    }
+
+    --reader_inst->remaining;
+
+    sample->series = header->series;
+    sample->timestamp_ns = reader_inst->prev_timestamp_ns;
+    sample->value = reader_inst->prev_value;
+
+    return true;
+}
+
+const smbus_log_series_t* smbus_log_reader_series(
+    smbus_log_reader_t log_reader,
+    uint16_t series
+)
+{
+    smbus_log_reader_inst_t* reader_inst = (smbus_log_reader_inst_t*)log_reader;
+
+    if(reader_inst == NULL || series >= SMBUS_LOG_SERIES_MAX || !reader_inst->is_known[series])
+    {
+        return NULL;
+    }
+
+    return &reader_inst->series[series];
+}
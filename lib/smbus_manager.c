@@ -0,0 +1,345 @@
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+
+#define SMBUS_MANAGER_BUSES_MAX 256
+#define SMBUS_MANAGER_DEV_DIR "/dev"
+#define SMBUS_MANAGER_EVENT_BUF_LEN 4096
+
+typedef struct smbus_manager_t
+{
+    pthread_mutex_t lock;
+    // Pooled handle of each bus, kept open after its last release
+    smbus_inst_t* buses[SMBUS_MANAGER_BUSES_MAX];
+    bool is_watch_started;
+    bool is_watching;
+    int inotify_fd;
+    int stop_fd;
+    pthread_t watcher;
+    smbus_bus_event_t callback;
+    void* callback_context;
+}
+smbus_manager_t;
+
+static smbus_manager_t smbus_manager = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .inotify_fd = -1,
+    .stop_fd = -1,
+};
+
+static void smbus_manager_start_watch(void);
+
+static void* smbus_manager_watch(
+    void* arg
+);
+
+static void smbus_manager_bus_event(
+    unsigned bus_index,
+    bool is_present
+);
+
+static void smbus_manager_reset(
+    smbus_inst_t* smbus_inst
+);
+
+smbus_handle_t smbus_acquire(
+    unsigned bus_index
+)
+{
+    if(bus_index >= SMBUS_MANAGER_BUSES_MAX)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    pthread_mutex_lock(&smbus_manager.lock);
+
+    smbus_manager_start_watch();
+
+    smbus_inst_t* smbus_inst = smbus_manager.buses[bus_index];
+
+    // Only the first use of a bus, or the first after it came back, opens the device
+    if(smbus_inst == NULL)
+    {
+        smbus_inst = smbus_open(bus_index);
+
+        if(smbus_inst == NULL)
+        {
+            pthread_mutex_unlock(&smbus_manager.lock);
+            return NULL;
+        }
+
+        smbus_inst->is_managed = true;
+        smbus_manager.buses[bus_index] = smbus_inst;
+    }
+
+    ++smbus_inst->manager_refs;
+
+    pthread_mutex_unlock(&smbus_manager.lock);
+
+    return smbus_inst;
+}
+
+bool smbus_release(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    pthread_mutex_lock(&smbus_manager.lock);
+
+    if(!smbus_inst->is_managed || smbus_inst->manager_refs == 0)
+    {
+        pthread_mutex_unlock(&smbus_manager.lock);
+
+        errno = EINVAL;
+        return false;
+    }
+
+    if(--smbus_inst->manager_refs != 0)
+    {
+        pthread_mutex_unlock(&smbus_manager.lock);
+        return true;
+    }
+
+    // A handle of a bus which went away is no longer pooled
+    if(smbus_inst->bus_index >= SMBUS_MANAGER_BUSES_MAX ||
+        smbus_manager.buses[smbus_inst->bus_index] != smbus_inst)
+    {
+        pthread_mutex_unlock(&smbus_manager.lock);
+        return smbus_inst_destroy(smbus_inst);
+    }
+
+    smbus_manager_reset(smbus_inst);
+
+    pthread_mutex_unlock(&smbus_manager.lock);
+
+    return true;
+}
+
+bool smbus_set_bus_event_callback(
+    smbus_bus_event_t callback,
+    void* context
+)
+{
+    pthread_mutex_lock(&smbus_manager.lock);
+
+    smbus_manager_start_watch();
+
+    smbus_manager.callback = callback;
+    smbus_manager.callback_context = context;
+
+    bool is_watching = smbus_manager.is_watching;
+
+    pthread_mutex_unlock(&smbus_manager.lock);
+
+    if(!is_watching)
+    {
+        errno = ENOSYS;
+    }
+
+    return is_watching;
+}
+
+void smbus_manager_shutdown(void)
+{
+    pthread_mutex_lock(&smbus_manager.lock);
+
+    bool is_watching = smbus_manager.is_watching;
+    int inotify_fd = smbus_manager.inotify_fd;
+    int stop_fd = smbus_manager.stop_fd;
+    pthread_t watcher = smbus_manager.watcher;
+
+    smbus_manager.is_watching = false;
+    smbus_manager.is_watch_started = false;
+    smbus_manager.inotify_fd = -1;
+    smbus_manager.stop_fd = -1;
+    smbus_manager.callback = NULL;
+
+    pthread_mutex_unlock(&smbus_manager.lock);
+
+    // The watcher takes the manager lock for its events, it is stopped without holding it
+    if(is_watching)
+    {
+        uint64_t value = 1;
+
+        if(write(stop_fd, &value, sizeof(value)) == sizeof(value))
+        {
+            pthread_join(watcher, NULL);
+        }
+
+        close(inotify_fd);
+        close(stop_fd);
+    }
+
+    pthread_mutex_lock(&smbus_manager.lock);
+
+    // Handles still in use are closed by their last release
+    for(unsigned i = 0; i < SMBUS_MANAGER_BUSES_MAX; ++i)
+    {
+        smbus_inst_t* smbus_inst = smbus_manager.buses[i];
+
+        if(smbus_inst == NULL)
+        {
+            continue;
+        }
+
+        smbus_manager.buses[i] = NULL;
+
+        if(smbus_inst->manager_refs == 0)
+        {
+            smbus_inst_destroy(smbus_inst);
+        }
+    }
+
+    pthread_mutex_unlock(&smbus_manager.lock);
+}
+
+void smbus_manager_start_watch(void)
+{
+    // A process without inotify keeps working, removed buses are just not noticed
+    if(smbus_manager.is_watch_started)
+    {
+        return;
+    }
+
+    smbus_manager.is_watch_started = true;
+    smbus_manager.inotify_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+    smbus_manager.stop_fd = eventfd(0, EFD_CLOEXEC);
+
+    if(smbus_manager.inotify_fd >= 0 && smbus_manager.stop_fd >= 0 &&
+        inotify_add_watch(smbus_manager.inotify_fd, SMBUS_MANAGER_DEV_DIR, IN_CREATE | IN_DELETE) >= 0 &&
+        pthread_create(&smbus_manager.watcher, NULL, smbus_manager_watch, NULL) == 0)
+    {
+        smbus_manager.is_watching = true;
+        return;
+    }
+
+    if(smbus_manager.inotify_fd >= 0)
+    {
+        close(smbus_manager.inotify_fd);
+    }
+
+    if(smbus_manager.stop_fd >= 0)
+    {
+        close(smbus_manager.stop_fd);
+    }
+
+    smbus_manager.inotify_fd = -1;
+    smbus_manager.stop_fd = -1;
+}
+
+void* smbus_manager_watch(
+    void* arg
+)
+{
+    // The manager is process wide, the thread takes no argument
+    (void)arg;
+
+    _Alignas(struct inotify_event) char buf[SMBUS_MANAGER_EVENT_BUF_LEN];
+    // Set before the thread was created, shutdown clears the fields before stopping it
+    int inotify_fd = smbus_manager.inotify_fd;
+    struct pollfd fds[2] = {
+        { .fd = inotify_fd, .events = POLLIN },
+        { .fd = smbus_manager.stop_fd, .events = POLLIN },
+    };
+
+    for(;;)
+    {
+        if(poll(fds, 2, -1) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+
+            break;
+        }
+
+        if(fds[1].revents & POLLIN)
+        {
+            break;
+        }
+
+        ssize_t len = read(inotify_fd, buf, sizeof(buf));
+
+        for(ssize_t offset = 0; offset < len; )
+        {
+            const struct inotify_event* event = (const struct inotify_event*)&buf[offset];
+            unsigned bus_index = 0;
+            char tail = 0;
+
+            offset += sizeof(struct inotify_event) + event->len;
+
+            if(event->len != 0 && sscanf(event->name, "i2c-%u%c", &bus_index, &tail) == 1)
+            {
+                smbus_manager_bus_event(bus_index, (event->mask & IN_CREATE) != 0);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void smbus_manager_bus_event(
+    unsigned bus_index,
+    bool is_present
+)
+{
+    pthread_mutex_lock(&smbus_manager.lock);
+
+    smbus_bus_event_t callback = smbus_manager.callback;
+    void* callback_context = smbus_manager.callback_context;
+
+    // The pooled fd of a removed bus is dead, the next acquire opens the new device
+    if(!is_present && bus_index < SMBUS_MANAGER_BUSES_MAX && smbus_manager.buses[bus_index] != NULL)
+    {
+        smbus_inst_t* smbus_inst = smbus_manager.buses[bus_index];
+        smbus_manager.buses[bus_index] = NULL;
+
+        if(smbus_inst->manager_refs == 0)
+        {
+            smbus_inst_destroy(smbus_inst);
+        }
+    }
+
+    pthread_mutex_unlock(&smbus_manager.lock);
+
+    if(callback != NULL)
+    {
+        callback(bus_index, is_present, callback_context);
+    }
+}
+
+void smbus_manager_reset(
+    smbus_inst_t* smbus_inst
+)
+{
+    // The next user starts from the state of a freshly opened bus, except for the slave
+    // address which every user selects under smbus_lock anyway
+    smbus_rt_stop(smbus_inst);
+    smbus_set_single_flight(smbus_inst, false, 0);
+    // Drops the deadline of the releasing thread and the adapter timeout it set
+    smbus_set_deadline(smbus_inst, 0);
+
+    smbus_inst_lock(smbus_inst);
+
+    if(smbus_inst->is_pec_enabled)
+    {
+        smbus_set_pec(smbus_inst, false);
+    }
+
+    smbus_inst->func_flags = smbus_inst->adapter_funcs;
+    smbus_inst->wire.clock_hz = SMBUS_CLOCK_HZ_DEFAULT;
+    // Descriptors of the last user need not outlive its job
+    smbus_device_plans_destroy(smbus_inst);
+
+    smbus_inst_unlock(smbus_inst);
+}
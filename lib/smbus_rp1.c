@@ -0,0 +1,592 @@
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <smbus_rp1.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Same default as the kernel adapter timeout
+#define SMBUS_RP1_TIMEOUT_MS 1000
+
+#define SMBUS_RP1_ABRT_ARB_LOST 0x1000
+
+static uint64_t smbus_rp1_now(void);
+
+static int smbus_rp1_check_abort(
+    smbus_rp1_t* rp1
+);
+
+static int smbus_rp1_wait(
+    smbus_rp1_t* rp1,
+    unsigned reg,
+    uint32_t mask,
+    uint32_t value,
+    uint64_t deadline
+);
+
+static int smbus_rp1_enable(
+    smbus_rp1_t* rp1,
+    bool is_enabled,
+    uint64_t deadline
+);
+
+static int smbus_rp1_set_target(
+    smbus_rp1_t* rp1,
+    uint16_t address,
+    uint64_t deadline
+);
+
+static int smbus_rp1_push(
+    smbus_rp1_t* rp1,
+    uint32_t value,
+    uint64_t deadline
+);
+
+static int smbus_rp1_pop(
+    smbus_rp1_t* rp1,
+    uint8_t* byte,
+    uint64_t deadline
+);
+
+static int smbus_rp1_write_msg(
+    smbus_rp1_t* rp1,
+    struct i2c_msg* msg,
+    bool is_restart,
+    bool is_stop,
+    uint64_t deadline
+);
+
+static int smbus_rp1_read_msg(
+    smbus_rp1_t* rp1,
+    struct i2c_msg* msg,
+    bool is_restart,
+    bool is_stop,
+    uint64_t deadline
+);
+
+static int smbus_rp1_transfer(
+    smbus_rp1_t* rp1,
+    struct i2c_rdwr_ioctl_data* rdwr
+);
+
+static smbus_handle_t smbus_rp1_open(
+    int fd,
+    unsigned bus_index,
+    uint64_t offset,
+    size_t map_len,
+    bool is_emulated
+);
+
+uint64_t smbus_rp1_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+int smbus_rp1_check_abort(
+    smbus_rp1_t* rp1
+)
+{
+    if((smbus_rp1_read(rp1, SMBUS_RP1_IC_RAW_INTR_STAT) & SMBUS_RP1_INTR_TX_ABRT) == 0)
+    {
+        return 0;
+    }
+
+    uint32_t source = smbus_rp1_read(rp1, SMBUS_RP1_IC_TX_ABRT_SOURCE);
+
+    // Reading the clear registers acknowledges the abort and the STOP that follows it
+    smbus_rp1_read(rp1, SMBUS_RP1_IC_CLR_INTR);
+
+    // Same codes as the kernel DesignWare driver
+    if(source & (SMBUS_RP1_ABRT_7B_ADDR_NOACK | SMBUS_RP1_ABRT_TXDATA_NOACK))
+    {
+        errno = EREMOTEIO;
+    }
+    else if(source & SMBUS_RP1_ABRT_ARB_LOST)
+    {
+        errno = EAGAIN;
+    }
+    else
+    {
+        errno = EIO;
+    }
+
+    return -1;
+}
+
+int smbus_rp1_wait(
+    smbus_rp1_t* rp1,
+    unsigned reg,
+    uint32_t mask,
+    uint32_t value,
+    uint64_t deadline
+)
+{
+    while((smbus_rp1_read(rp1, reg) & mask) != value)
+    {
+        if(smbus_rp1_check_abort(rp1) < 0)
+        {
+            return -1;
+        }
+
+        if(smbus_rp1_now() > deadline)
+        {
+            errno = ETIMEDOUT;
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int smbus_rp1_enable(
+    smbus_rp1_t* rp1,
+    bool is_enabled,
+    uint64_t deadline
+)
+{
+    smbus_rp1_write(rp1, SMBUS_RP1_IC_ENABLE, is_enabled ? 1 : 0);
+
+    return smbus_rp1_wait(rp1, SMBUS_RP1_IC_ENABLE_STATUS, 1, is_enabled ? 1 : 0, deadline);
+}
+
+int smbus_rp1_set_target(
+    smbus_rp1_t* rp1,
+    uint16_t address,
+    uint64_t deadline
+)
+{
+    if(rp1->is_target_set && rp1->target == address)
+    {
+        return 0;
+    }
+
+    if(smbus_rp1_enable(rp1, false, deadline) < 0)
+    {
+        return -1;
+    }
+
+    smbus_rp1_write(rp1, SMBUS_RP1_IC_TAR, address);
+    rp1->target = address;
+    rp1->is_target_set = true;
+
+    return smbus_rp1_enable(rp1, true, deadline);
+}
+
+int smbus_rp1_push(
+    smbus_rp1_t* rp1,
+    uint32_t value,
+    uint64_t deadline
+)
+{
+    if(smbus_rp1_wait(rp1, SMBUS_RP1_IC_STATUS, SMBUS_RP1_STATUS_TFNF, SMBUS_RP1_STATUS_TFNF, deadline) < 0)
+    {
+        return -1;
+    }
+
+    smbus_rp1_write(rp1, SMBUS_RP1_IC_DATA_CMD, value);
+
+    return 0;
+}
+
+int smbus_rp1_pop(
+    smbus_rp1_t* rp1,
+    uint8_t* byte,
+    uint64_t deadline
+)
+{
+    if(smbus_rp1_wait(rp1, SMBUS_RP1_IC_STATUS, SMBUS_RP1_STATUS_RFNE, SMBUS_RP1_STATUS_RFNE, deadline) < 0)
+    {
+        return -1;
+    }
+
+    *byte = smbus_rp1_read(rp1, SMBUS_RP1_IC_DATA_CMD) & 0xFF;
+
+    return 0;
+}
+
+int smbus_rp1_write_msg(
+    smbus_rp1_t* rp1,
+    struct i2c_msg* msg,
+    bool is_restart,
+    bool is_stop,
+    uint64_t deadline
+)
+{
+    for(uint16_t i = 0; i < msg->len; ++i)
+    {
+        uint32_t value = msg->buf[i];
+
+        if(i == 0 && is_restart)
+        {
+            value |= SMBUS_RP1_DATA_CMD_RESTART;
+        }
+
+        if(i == msg->len - 1 && is_stop)
+        {
+            value |= SMBUS_RP1_DATA_CMD_STOP;
+        }
+
+        if(smbus_rp1_push(rp1, value, deadline) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int smbus_rp1_read_msg(
+    smbus_rp1_t* rp1,
+    struct i2c_msg* msg,
+    bool is_restart,
+    bool is_stop,
+    uint64_t deadline
+)
+{
+    bool is_recv_len = (msg->flags & I2C_M_RECV_LEN) != 0;
+    // Bytes expected besides the block, i.e. the count byte and the PEC
+    uint8_t extra = is_recv_len ? msg->buf[0] : 0;
+    uint16_t total = is_recv_len ? 1 : msg->len;
+    uint16_t issued = 0;
+    uint16_t received = 0;
+
+    while(received < total)
+    {
+        // Keep the RX FIFO from overflowing, the controller NACKs nothing on its own
+        if(issued < total && (unsigned)(issued - received) < rp1->rx_depth)
+        {
+            uint32_t value = SMBUS_RP1_DATA_CMD_READ;
+
+            if(issued == 0 && is_restart)
+            {
+                value |= SMBUS_RP1_DATA_CMD_RESTART;
+            }
+
+            // The block length byte is never the last one
+            if(issued == total - 1 && is_stop && !(is_recv_len && issued == 0))
+            {
+                value |= SMBUS_RP1_DATA_CMD_STOP;
+            }
+
+            if(smbus_rp1_push(rp1, value, deadline) < 0)
+            {
+                return -1;
+            }
+
+            ++issued;
+            continue;
+        }
+
+        if(smbus_rp1_pop(rp1, &msg->buf[received++], deadline) < 0)
+        {
+            return -1;
+        }
+
+        if(is_recv_len && received == 1)
+        {
+            uint8_t count = msg->buf[0];
+
+            if(count == 0 || count > SMBUS_BLOCK_MAX)
+            {
+                // Terminate the transaction before reporting the bad length
+                if(is_stop && (smbus_rp1_push(rp1, SMBUS_RP1_DATA_CMD_READ | SMBUS_RP1_DATA_CMD_STOP, deadline) < 0 ||
+                    smbus_rp1_pop(rp1, &msg->buf[1], deadline) < 0))
+                {
+                    return -1;
+                }
+
+                errno = EPROTO;
+                return -1;
+            }
+
+            total = count + extra;
+            msg->len = total;
+        }
+    }
+
+    return 0;
+}
+
+int smbus_rp1_transfer(
+    smbus_rp1_t* rp1,
+    struct i2c_rdwr_ioctl_data* rdwr
+)
+{
+    uint64_t deadline = smbus_rp1_now() + (uint64_t)rp1->timeout_ms * 1000000ULL;
+    bool is_stopped = false;
+
+    for(unsigned i = 0; i < rdwr->nmsgs; ++i)
+    {
+        struct i2c_msg* msg = &rdwr->msgs[i];
+        bool is_read = (msg->flags & I2C_M_RD) != 0;
+        int res = 0;
+
+        // The controller cannot send an address without data, nor SMBus quick commands
+        if((msg->flags & I2C_M_TEN) || msg->len == 0)
+        {
+            errno = EOPNOTSUPP;
+            return -1;
+        }
+
+        // A new address needs IC_TAR reprogramming. Every SMBus transaction ends with a STOP,
+        // only the write and read of one transaction are joined by a repeated START.
+        bool is_first = (i == 0) || rdwr->msgs[i - 1].addr != msg->addr;
+        bool is_restart = !is_first && !is_stopped;
+        bool is_stop = (i == rdwr->nmsgs - 1) || rdwr->msgs[i + 1].addr != msg->addr ||
+            is_read || (rdwr->msgs[i + 1].flags & I2C_M_RD) == 0;
+
+        is_stopped = is_stop;
+
+        if(is_first && smbus_rp1_set_target(rp1, msg->addr, deadline) < 0)
+        {
+            return -1;
+        }
+
+        if(is_read)
+        {
+            res = smbus_rp1_read_msg(rp1, msg, is_restart, is_stop, deadline);
+        }
+        else
+        {
+            res = smbus_rp1_write_msg(rp1, msg, is_restart, is_stop, deadline);
+        }
+
+        if(res == 0 && is_stop)
+        {
+            res = smbus_rp1_wait(rp1, SMBUS_RP1_IC_RAW_INTR_STAT, SMBUS_RP1_INTR_STOP_DET, SMBUS_RP1_INTR_STOP_DET, deadline);
+
+            // An abort also ends with a STOP, writes only notice the NACK here
+            if(res == 0)
+            {
+                res = smbus_rp1_check_abort(rp1);
+            }
+
+            smbus_rp1_read(rp1, SMBUS_RP1_IC_CLR_STOP_DET);
+        }
+
+        if(res < 0)
+        {
+            int error = errno;
+
+            // Drop whatever is left of the transaction
+            if(error == ETIMEDOUT || error == EPROTO)
+            {
+                smbus_rp1_enable(rp1, false, smbus_rp1_now() + 1000000ULL);
+                smbus_rp1_read(rp1, SMBUS_RP1_IC_CLR_INTR);
+                smbus_rp1_enable(rp1, true, smbus_rp1_now() + 1000000ULL);
+            }
+
+            errno = error;
+            return -1;
+        }
+    }
+
+    return rdwr->nmsgs;
+}
+
+int smbus_rp1_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+)
+{
+    smbus_rp1_t* rp1 = smbus_inst->rp1;
+
+    switch(request)
+    {
+        case I2C_RDWR:
+            return smbus_rp1_transfer(rp1, (struct i2c_rdwr_ioctl_data*)arg);
+
+        // Every message carries its own address, PEC is done in software
+        case I2C_SLAVE:
+        case I2C_SLAVE_FORCE:
+        case I2C_PEC:
+            return 0;
+
+        case I2C_TIMEOUT:
+            // In units of 10 ms, as for i2c-dev
+            rp1->timeout_ms = (unsigned long)arg * 10;
+            return 0;
+
+        case I2C_FUNCS:
+            *(unsigned long*)arg = I2C_FUNC_I2C;
+            return 0;
+    }
+
+    errno = ENOTTY;
+    return -1;
+}
+
+smbus_rp1_t* smbus_rp1_create(
+    int fd,
+    uint64_t offset,
+    size_t map_len,
+    bool is_emulated
+)
+{
+    smbus_rp1_t* rp1 = calloc(1, sizeof(smbus_rp1_t));
+
+    if(rp1 == NULL)
+    {
+        return NULL;
+    }
+
+    rp1->map = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+
+    if(rp1->map == MAP_FAILED)
+    {
+        free(rp1);
+        return NULL;
+    }
+
+    rp1->map_len = map_len;
+    rp1->regs = (volatile uint32_t*)rp1->map;
+    rp1->timeout_ms = SMBUS_RP1_TIMEOUT_MS;
+
+    if(is_emulated)
+    {
+        rp1->emul = (smbus_rp1_emul_t*)rp1->map;
+        smbus_rp1_emul_init(rp1->emul);
+    }
+
+    if(smbus_rp1_read(rp1, SMBUS_RP1_IC_COMP_TYPE) != SMBUS_RP1_COMP_TYPE_DW)
+    {
+        munmap(rp1->map, rp1->map_len);
+        free(rp1);
+
+        errno = ENODEV;
+        return NULL;
+    }
+
+    uint32_t param = smbus_rp1_read(rp1, SMBUS_RP1_IC_COMP_PARAM_1);
+    rp1->tx_depth = SMBUS_RP1_TX_DEPTH(param);
+    rp1->rx_depth = SMBUS_RP1_RX_DEPTH(param);
+
+    // Keep the bus speed and SCL timings programmed by the firmware or the unbound driver
+    uint64_t deadline = smbus_rp1_now() + (uint64_t)rp1->timeout_ms * 1000000ULL;
+    uint32_t con = smbus_rp1_read(rp1, SMBUS_RP1_IC_CON) & SMBUS_RP1_CON_SPEED_MASK;
+
+    if(con == 0)
+    {
+        con = SMBUS_RP1_CON_SPEED_STD;
+    }
+
+    if(smbus_rp1_enable(rp1, false, deadline) < 0)
+    {
+        munmap(rp1->map, rp1->map_len);
+        free(rp1);
+        return NULL;
+    }
+
+    smbus_rp1_write(rp1, SMBUS_RP1_IC_CON,
+        con | SMBUS_RP1_CON_MASTER | SMBUS_RP1_CON_RESTART_EN | SMBUS_RP1_CON_SLAVE_DISABLE);
+    // Transfers are polled, nothing may raise the (unhandled) interrupt line
+    smbus_rp1_write(rp1, SMBUS_RP1_IC_INTR_MASK, 0);
+    smbus_rp1_read(rp1, SMBUS_RP1_IC_CLR_INTR);
+
+    return rp1;
+}
+
+void smbus_rp1_destroy(
+    smbus_inst_t* smbus_inst
+)
+{
+    smbus_rp1_t* rp1 = smbus_inst->rp1;
+
+    if(rp1 == NULL)
+    {
+        return;
+    }
+
+    smbus_inst->rp1 = NULL;
+
+    munmap(rp1->map, rp1->map_len);
+    free(rp1);
+}
+
+smbus_handle_t smbus_rp1_open(
+    int fd,
+    unsigned bus_index,
+    uint64_t offset,
+    size_t map_len,
+    bool is_emulated
+)
+{
+    smbus_rp1_t* rp1 = smbus_rp1_create(fd, offset, map_len, is_emulated);
+
+    if(rp1 == NULL)
+    {
+        int error = errno;
+        close(fd);
+
+        errno = error;
+        return NULL;
+    }
+
+    smbus_inst_t* smbus_inst = smbus_inst_create(fd, bus_index);
+
+    if(smbus_inst == NULL)
+    {
+        munmap(rp1->map, rp1->map_len);
+        free(rp1);
+        close(fd);
+
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    smbus_inst->rp1 = rp1;
+    smbus_inst->func_flags = I2C_FUNC_I2C;
+    smbus_inst->adapter_funcs = I2C_FUNC_I2C;
+
+    return smbus_inst;
+}
+
+smbus_handle_t smbus_open_rp1(
+    unsigned bus_index,
+    const char* mem_path,
+    uint64_t offset
+)
+{
+    int fd = open(mem_path, O_RDWR | O_SYNC);
+
+    if(fd < 0)
+    {
+        return NULL;
+    }
+
+    return smbus_rp1_open(fd, bus_index, offset, SMBUS_RP1_REG_SIZE, false);
+}
+
+smbus_handle_t smbus_open_rp1_emul(
+    const char* path
+)
+{
+    struct stat file_stat;
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+
+    if(fd < 0)
+    {
+        return NULL;
+    }
+
+    if(fstat(fd, &file_stat) < 0 ||
+        ((size_t)file_stat.st_size < smbus_rp1_emul_size() && ftruncate(fd, smbus_rp1_emul_size()) < 0))
+    {
+        int error = errno;
+        close(fd);
+
+        errno = error;
+        return NULL;
+    }
+
+    return smbus_rp1_open(fd, 0, 0, smbus_rp1_emul_size(), true);
+}
@@ -0,0 +1,618 @@
+#include <smbus/smbus.h>
+#include <smbus/smbus_arp.h>
+#include <smbus_inst.h>
+#include <smbus_rp1.h>
+#include <smbus_pec.h>
+#include <string.h>
+#include <errno.h>
+
+#define SMBUS_RP1_EMUL_FIFO_DEPTH 32
+#define SMBUS_RP1_EMUL_ADDRESSES 128
+#define SMBUS_RP1_EMUL_MEMORY 256
+// Command, block length, block data and PEC
+#define SMBUS_RP1_EMUL_PENDING_MAX (SMBUS_BLOCK_MAX + 3)
+#define SMBUS_RP1_EMUL_ARP_DEVICES 64
+
+// Emulated targets are register pointer memories, like a 24C02 EEPROM: the
+// first written byte of a transaction selects the register, further bytes are
+// stored from there on and reads continue from the pointer. Targets with PEC
+// check it on writes (NACKing a bad one) and send it as the last byte of reads.
+// ARP devices share the device default address, where ARP commands are decoded
+// on commit and Get UDID responses are staged in its memory; once assigned they
+// answer at their own address like the other targets.
+typedef struct smbus_rp1_emul_arp_t
+{
+    uint8_t udid[SMBUS_ARP_UDID_LEN];
+    uint8_t address;
+    // Address Resolved flag, set by Assign Address
+    uint8_t is_resolved;
+}
+smbus_rp1_emul_arp_t;
+
+struct smbus_rp1_emul_t
+{
+    // Register block first, laid out like a mapping of the real controller
+    uint32_t regs[SMBUS_RP1_REG_SIZE / sizeof(uint32_t)];
+
+    uint8_t rx_fifo[SMBUS_RP1_EMUL_FIFO_DEPTH];
+    uint8_t rx_head;
+    uint8_t rx_count;
+    uint8_t is_active;
+    uint8_t is_aborted;
+    uint8_t is_reading;
+    uint8_t is_pointer_set;
+    uint8_t pointer;
+    uint8_t crc;
+    // Written data held back until STOP, its last byte may be the PEC
+    uint8_t pending_count;
+    uint8_t pending[SMBUS_RP1_EMUL_PENDING_MAX];
+
+    uint8_t is_present[SMBUS_RP1_EMUL_ADDRESSES];
+    uint8_t is_pec_enabled[SMBUS_RP1_EMUL_ADDRESSES];
+    uint8_t memory[SMBUS_RP1_EMUL_ADDRESSES][SMBUS_RP1_EMUL_MEMORY];
+
+    uint8_t arp_count;
+    smbus_rp1_emul_arp_t arp[SMBUS_RP1_EMUL_ARP_DEVICES];
+};
+
+static inline uint32_t* smbus_rp1_emul_reg(
+    smbus_rp1_emul_t* emul,
+    unsigned reg
+);
+
+static void smbus_rp1_emul_reset(
+    smbus_rp1_emul_t* emul
+);
+
+static void smbus_rp1_emul_abort(
+    smbus_rp1_emul_t* emul,
+    uint32_t source
+);
+
+static bool smbus_rp1_emul_commit(
+    smbus_rp1_emul_t* emul,
+    uint8_t address
+);
+
+static void smbus_rp1_emul_arp_set_address(
+    smbus_rp1_emul_t* emul,
+    smbus_rp1_emul_arp_t* arp,
+    uint8_t address
+);
+
+static bool smbus_rp1_emul_arp_write(
+    smbus_rp1_emul_t* emul,
+    uint8_t command,
+    const uint8_t* data,
+    uint8_t length
+);
+
+static bool smbus_rp1_emul_arp_respond(
+    smbus_rp1_emul_t* emul
+);
+
+static void smbus_rp1_emul_data_cmd(
+    smbus_rp1_emul_t* emul,
+    uint32_t value
+);
+
+static smbus_rp1_emul_t* smbus_rp1_emul_get(
+    smbus_handle_t smbus_handle
+);
+
+uint32_t* smbus_rp1_emul_reg(
+    smbus_rp1_emul_t* emul,
+    unsigned reg
+)
+{
+    return &emul->regs[reg / sizeof(uint32_t)];
+}
+
+size_t smbus_rp1_emul_size(void)
+{
+    return sizeof(smbus_rp1_emul_t);
+}
+
+void smbus_rp1_emul_init(
+    smbus_rp1_emul_t* emul
+)
+{
+    if(*smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_COMP_TYPE) == SMBUS_RP1_COMP_TYPE_DW)
+    {
+        smbus_rp1_emul_reset(emul);
+        return;
+    }
+
+    memset(emul, 0, sizeof(smbus_rp1_emul_t));
+
+    *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_COMP_TYPE) = SMBUS_RP1_COMP_TYPE_DW;
+    *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_COMP_PARAM_1) =
+        ((SMBUS_RP1_EMUL_FIFO_DEPTH - 1) << 16) | ((SMBUS_RP1_EMUL_FIFO_DEPTH - 1) << 8);
+    *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_CON) =
+        SMBUS_RP1_CON_MASTER | SMBUS_RP1_CON_SPEED_STD | SMBUS_RP1_CON_RESTART_EN | SMBUS_RP1_CON_SLAVE_DISABLE;
+}
+
+void smbus_rp1_emul_reset(
+    smbus_rp1_emul_t* emul
+)
+{
+    // Disabling the controller flushes the FIFOs and drops the transaction
+    emul->rx_head = 0;
+    emul->rx_count = 0;
+    emul->is_active = 0;
+    emul->is_aborted = 0;
+    emul->pending_count = 0;
+}
+
+void smbus_rp1_emul_abort(
+    smbus_rp1_emul_t* emul,
+    uint32_t source
+)
+{
+    smbus_rp1_emul_reset(emul);
+
+    emul->is_aborted = 1;
+    *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_TX_ABRT_SOURCE) = source;
+    *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_RAW_INTR_STAT) |= SMBUS_RP1_INTR_TX_ABRT | SMBUS_RP1_INTR_STOP_DET;
+}
+
+bool smbus_rp1_emul_commit(
+    smbus_rp1_emul_t* emul,
+    uint8_t address
+)
+{
+    uint8_t count = emul->pending_count;
+    uint8_t crc = emul->crc;
+
+    emul->pending_count = 0;
+
+    if(count == 0)
+    {
+        return true;
+    }
+
+    for(uint8_t i = 0; i + 1 < count; ++i)
+    {
+        crc = smbus_pec_single(crc, emul->pending[i]);
+    }
+
+    if(crc != emul->pending[count - 1])
+    {
+        smbus_rp1_emul_abort(emul, SMBUS_RP1_ABRT_TXDATA_NOACK);
+        return false;
+    }
+
+    if(address == SMBUS_ARP_ADDRESS)
+    {
+        if(!smbus_rp1_emul_arp_write(emul, emul->pointer, emul->pending, count - 1))
+        {
+            smbus_rp1_emul_abort(emul, SMBUS_RP1_ABRT_TXDATA_NOACK);
+            return false;
+        }
+    }
+    else
+    {
+        for(uint8_t i = 0; i + 1 < count; ++i)
+        {
+            emul->memory[address][emul->pointer++] = emul->pending[i];
+        }
+    }
+
+    emul->crc = smbus_pec_single(crc, emul->pending[count - 1]);
+
+    return true;
+}
+
+void smbus_rp1_emul_arp_set_address(
+    smbus_rp1_emul_t* emul,
+    smbus_rp1_emul_arp_t* arp,
+    uint8_t address
+)
+{
+    if(arp->address < SMBUS_RP1_EMUL_ADDRESSES)
+    {
+        emul->is_present[arp->address] = 0;
+    }
+
+    arp->address = address;
+
+    if(address < SMBUS_RP1_EMUL_ADDRESSES)
+    {
+        emul->is_present[address] = 1;
+    }
+}
+
+bool smbus_rp1_emul_arp_write(
+    smbus_rp1_emul_t* emul,
+    uint8_t command,
+    const uint8_t* data,
+    uint8_t length
+)
+{
+    switch(command)
+    {
+        case SMBUS_ARP_PREPARE:
+            for(uint8_t i = 0; i < emul->arp_count; ++i)
+            {
+                emul->arp[i].is_resolved = 0;
+            }
+            return true;
+
+        case SMBUS_ARP_RESET_DEVICE:
+            for(uint8_t i = 0; i < emul->arp_count; ++i)
+            {
+                smbus_rp1_emul_arp_t* arp = &emul->arp[i];
+
+                arp->is_resolved = 0;
+
+                // Only persistent and fixed addresses survive a reset
+                if(SMBUS_ARP_ADDRESS_TYPE(arp->udid) >= SMBUS_ARP_DYNAMIC_VOLATILE)
+                {
+                    smbus_rp1_emul_arp_set_address(emul, arp, SMBUS_ARP_NO_ADDRESS);
+                }
+            }
+            return true;
+
+        case SMBUS_ARP_ASSIGN_ADDRESS:
+            if(length != SMBUS_ARP_UDID_LEN + 2 || data[0] != SMBUS_ARP_UDID_LEN + 1)
+            {
+                return false;
+            }
+
+            // Devices with another UDID stop acknowledging, nobody left means a NACK
+            for(uint8_t i = 0; i < emul->arp_count; ++i)
+            {
+                smbus_rp1_emul_arp_t* arp = &emul->arp[i];
+
+                if(memcmp(arp->udid, &data[1], SMBUS_ARP_UDID_LEN) == 0)
+                {
+                    smbus_rp1_emul_arp_set_address(emul, arp, data[SMBUS_ARP_UDID_LEN + 1] >> 1);
+                    arp->is_resolved = 1;
+                    return true;
+                }
+            }
+            return false;
+    }
+
+    // Directed Reset Device, the address is part of the command code
+    for(uint8_t i = 0; i < emul->arp_count && (command & 1) == 0; ++i)
+    {
+        smbus_rp1_emul_arp_t* arp = &emul->arp[i];
+
+        if(arp->address == (command >> 1))
+        {
+            arp->is_resolved = 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool smbus_rp1_emul_arp_respond(
+    smbus_rp1_emul_t* emul
+)
+{
+    smbus_rp1_emul_arp_t* winner = NULL;
+    uint8_t command = emul->pointer;
+
+    for(uint8_t i = 0; i < emul->arp_count; ++i)
+    {
+        smbus_rp1_emul_arp_t* arp = &emul->arp[i];
+
+        if(command == SMBUS_ARP_GET_UDID)
+        {
+            // Wired-AND arbitration, MSB first: the lowest unresolved UDID is read
+            if(!arp->is_resolved && (winner == NULL || memcmp(arp->udid, winner->udid, SMBUS_ARP_UDID_LEN) < 0))
+            {
+                winner = arp;
+            }
+        }
+        else if((command & 1) && command > SMBUS_ARP_ASSIGN_ADDRESS && arp->address == (command >> 1))
+        {
+            winner = arp;
+        }
+    }
+
+    if(winner == NULL)
+    {
+        return false;
+    }
+
+    uint8_t* memory = emul->memory[SMBUS_ARP_ADDRESS];
+
+    memory[command] = SMBUS_ARP_UDID_LEN + 1;
+
+    for(uint8_t i = 0; i < SMBUS_ARP_UDID_LEN; ++i)
+    {
+        memory[(uint8_t)(command + 1 + i)] = winner->udid[i];
+    }
+
+    memory[(uint8_t)(command + 1 + SMBUS_ARP_UDID_LEN)] =
+        (winner->address == SMBUS_ARP_NO_ADDRESS) ? SMBUS_ARP_NO_ADDRESS : (winner->address << 1) | 1;
+
+    return true;
+}
+
+void smbus_rp1_emul_data_cmd(
+    smbus_rp1_emul_t* emul,
+    uint32_t value
+)
+{
+    uint8_t address = *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_TAR) & 0x7F;
+    bool is_read = (value & SMBUS_RP1_DATA_CMD_READ) != 0;
+
+    // The hardware flushes the TX FIFO until the abort is cleared
+    if(emul->is_aborted || (*smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_ENABLE) & 1) == 0)
+    {
+        return;
+    }
+
+    if(!emul->is_active)
+    {
+        emul->crc = 0;
+        emul->is_pointer_set = 0;
+        emul->pending_count = 0;
+    }
+
+    if(!emul->is_active || (value & SMBUS_RP1_DATA_CMD_RESTART) || is_read != emul->is_reading)
+    {
+        if(emul->is_active && !emul->is_reading && !smbus_rp1_emul_commit(emul, address))
+        {
+            return;
+        }
+
+        // A repeated START into a write begins the next transaction of a batch
+        if(!is_read)
+        {
+            emul->crc = 0;
+            emul->is_pointer_set = 0;
+            emul->pending_count = 0;
+        }
+
+        if(!emul->is_present[address])
+        {
+            smbus_rp1_emul_abort(emul, SMBUS_RP1_ABRT_7B_ADDR_NOACK);
+            return;
+        }
+
+        if(is_read && address == SMBUS_ARP_ADDRESS && !smbus_rp1_emul_arp_respond(emul))
+        {
+            smbus_rp1_emul_abort(emul, SMBUS_RP1_ABRT_7B_ADDR_NOACK);
+            return;
+        }
+
+        emul->crc = smbus_pec_single(emul->crc, (address << 1) | (is_read ? 1 : 0));
+        emul->is_active = 1;
+        emul->is_reading = is_read;
+    }
+
+    if(is_read)
+    {
+        uint8_t byte = 0;
+
+        if((value & SMBUS_RP1_DATA_CMD_STOP) && emul->is_pec_enabled[address])
+        {
+            byte = emul->crc;
+        }
+        else
+        {
+            byte = emul->memory[address][emul->pointer++];
+        }
+
+        emul->crc = smbus_pec_single(emul->crc, byte);
+
+        if(emul->rx_count < SMBUS_RP1_EMUL_FIFO_DEPTH)
+        {
+            emul->rx_fifo[(emul->rx_head + emul->rx_count++) % SMBUS_RP1_EMUL_FIFO_DEPTH] = byte;
+        }
+    }
+    else
+    {
+        uint8_t byte = value & 0xFF;
+
+        if(!emul->is_pointer_set)
+        {
+            emul->pointer = byte;
+            emul->is_pointer_set = 1;
+            emul->crc = smbus_pec_single(emul->crc, byte);
+        }
+        else if(emul->is_pec_enabled[address])
+        {
+            if(emul->pending_count == SMBUS_RP1_EMUL_PENDING_MAX)
+            {
+                smbus_rp1_emul_abort(emul, SMBUS_RP1_ABRT_TXDATA_NOACK);
+                return;
+            }
+
+            emul->pending[emul->pending_count++] = byte;
+        }
+        else
+        {
+            emul->memory[address][emul->pointer++] = byte;
+            emul->crc = smbus_pec_single(emul->crc, byte);
+        }
+    }
+
+    if(value & SMBUS_RP1_DATA_CMD_STOP)
+    {
+        if(!emul->is_reading && !smbus_rp1_emul_commit(emul, address))
+        {
+            return;
+        }
+
+        emul->is_active = 0;
+        *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_RAW_INTR_STAT) |= SMBUS_RP1_INTR_STOP_DET;
+    }
+}
+
+uint32_t smbus_rp1_emul_read(
+    smbus_rp1_emul_t* emul,
+    unsigned reg
+)
+{
+    uint32_t* raw_intr = smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_RAW_INTR_STAT);
+
+    switch(reg)
+    {
+        case SMBUS_RP1_IC_DATA_CMD:
+        {
+            if(emul->rx_count == 0)
+            {
+                return 0;
+            }
+
+            uint8_t byte = emul->rx_fifo[emul->rx_head];
+            emul->rx_head = (emul->rx_head + 1) % SMBUS_RP1_EMUL_FIFO_DEPTH;
+            --emul->rx_count;
+
+            return byte;
+        }
+
+        case SMBUS_RP1_IC_STATUS:
+            return SMBUS_RP1_STATUS_TFNF | SMBUS_RP1_STATUS_TFE |
+                (emul->rx_count ? SMBUS_RP1_STATUS_RFNE : 0) |
+                (emul->is_active ? SMBUS_RP1_STATUS_ACTIVITY : 0);
+
+        case SMBUS_RP1_IC_TXFLR:
+            return 0;
+
+        case SMBUS_RP1_IC_RXFLR:
+            return emul->rx_count;
+
+        case SMBUS_RP1_IC_ENABLE_STATUS:
+            return *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_ENABLE) & 1;
+
+        case SMBUS_RP1_IC_CLR_TX_ABRT:
+            *raw_intr &= ~SMBUS_RP1_INTR_TX_ABRT;
+            *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_TX_ABRT_SOURCE) = 0;
+            emul->is_aborted = 0;
+            return 0;
+
+        case SMBUS_RP1_IC_CLR_STOP_DET:
+            *raw_intr &= ~SMBUS_RP1_INTR_STOP_DET;
+            return 0;
+
+        case SMBUS_RP1_IC_CLR_INTR:
+            *raw_intr = 0;
+            *smbus_rp1_emul_reg(emul, SMBUS_RP1_IC_TX_ABRT_SOURCE) = 0;
+            emul->is_aborted = 0;
+            return 0;
+    }
+
+    return *smbus_rp1_emul_reg(emul, reg);
+}
+
+void smbus_rp1_emul_write(
+    smbus_rp1_emul_t* emul,
+    unsigned reg,
+    uint32_t value
+)
+{
+    switch(reg)
+    {
+        case SMBUS_RP1_IC_DATA_CMD:
+            smbus_rp1_emul_data_cmd(emul, value);
+            return;
+
+        case SMBUS_RP1_IC_ENABLE:
+            if((value & 1) == 0)
+            {
+                smbus_rp1_emul_reset(emul);
+            }
+            break;
+
+        // Read-only registers
+        case SMBUS_RP1_IC_STATUS:
+        case SMBUS_RP1_IC_TXFLR:
+        case SMBUS_RP1_IC_RXFLR:
+        case SMBUS_RP1_IC_RAW_INTR_STAT:
+        case SMBUS_RP1_IC_TX_ABRT_SOURCE:
+        case SMBUS_RP1_IC_ENABLE_STATUS:
+        case SMBUS_RP1_IC_COMP_PARAM_1:
+        case SMBUS_RP1_IC_COMP_TYPE:
+            return;
+    }
+
+    *smbus_rp1_emul_reg(emul, reg) = value;
+}
+
+smbus_rp1_emul_t* smbus_rp1_emul_get(
+    smbus_handle_t smbus_handle
+)
+{
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    if(smbus_inst == NULL || smbus_inst->rp1 == NULL || smbus_inst->rp1->emul == NULL)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return smbus_inst->rp1->emul;
+}
+
+bool smbus_rp1_emul_add_device(
+    smbus_handle_t smbus_handle,
+    uint8_t address,
+    bool is_pec_enabled
+)
+{
+    smbus_rp1_emul_t* emul = smbus_rp1_emul_get(smbus_handle);
+
+    if(emul == NULL || address >= SMBUS_RP1_EMUL_ADDRESSES)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    emul->is_present[address] = 1;
+    emul->is_pec_enabled[address] = is_pec_enabled;
+
+    return true;
+}
+
+uint8_t* smbus_rp1_emul_memory(
+    smbus_handle_t smbus_handle,
+    uint8_t address
+)
+{
+    smbus_rp1_emul_t* emul = smbus_rp1_emul_get(smbus_handle);
+
+    if(emul == NULL || address >= SMBUS_RP1_EMUL_ADDRESSES)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    return emul->memory[address];
+}
+
+bool smbus_rp1_emul_add_arp_device(
+    smbus_handle_t smbus_handle,
+    const uint8_t* udid,
+    uint8_t address
+)
+{
+    smbus_rp1_emul_t* emul = smbus_rp1_emul_get(smbus_handle);
+
+    if(emul == NULL || udid == NULL || emul->arp_count == SMBUS_RP1_EMUL_ARP_DEVICES ||
+        (address != SMBUS_ARP_NO_ADDRESS && address >= SMBUS_RP1_EMUL_ADDRESSES))
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    smbus_rp1_emul_arp_t* arp = &emul->arp[emul->arp_count++];
+
+    memcpy(arp->udid, udid, SMBUS_ARP_UDID_LEN);
+    arp->address = SMBUS_ARP_NO_ADDRESS;
+    arp->is_resolved = 0;
+    smbus_rp1_emul_arp_set_address(emul, arp, address);
+
+    // ARP traffic always carries a PEC
+    emul->is_present[SMBUS_ARP_ADDRESS] = 1;
+    emul->is_pec_enabled[SMBUS_ARP_ADDRESS] = 1;
+
+    return true;
+}
@@ -0,0 +1,372 @@
+#define _GNU_SOURCE
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <alloca.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#define SMBUS_RT_STACK_DEFAULT (64 * 1024)
+// Part of the worker stack left to the frames which pre-fault the rest
+#define SMBUS_RT_STACK_MARGIN (8 * 1024)
+#define SMBUS_RT_CACHE_LINE 64
+// Polls before an unpinned worker or its submitter sleeps on the mailbox futex
+#define SMBUS_RT_SPIN_LIMIT 4096
+
+typedef enum smbus_rt_state_t
+{
+    SMBUS_RT_STARTING,
+    SMBUS_RT_IDLE,
+    SMBUS_RT_REQUEST,
+    SMBUS_RT_DONE,
+    SMBUS_RT_STOP,
+}
+smbus_rt_state_t;
+
+struct smbus_rt_t
+{
+    // Mailbox shared by the submitter and the worker, on its own cache line
+    _Alignas(SMBUS_RT_CACHE_LINE) atomic_int state;
+    unsigned long request;
+    void* arg;
+    int res;
+    int error;
+    // Threads asleep on state, the other side only wakes them when there are any
+    atomic_uint sleepers;
+
+    _Alignas(SMBUS_RT_CACHE_LINE) smbus_inst_t* smbus_inst;
+    size_t stack_size;
+    bool is_memory_locked;
+    // A pinned worker owns its core and never sleeps, nor does its submitter
+    bool is_pinned;
+    pthread_t worker;
+};
+
+// mlockall is process wide, memory stays locked while any worker needs it
+static pthread_mutex_t smbus_rt_memory_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned smbus_rt_memory_users = 0;
+
+static void* smbus_rt_worker(
+    void* arg
+);
+
+static bool smbus_rt_lock_memory(void);
+
+static void smbus_rt_unlock_memory(void);
+
+static void smbus_rt_destroy(
+    smbus_rt_t* rt
+);
+
+static inline void smbus_rt_relax(
+    smbus_rt_t* rt,
+    int state,
+    unsigned* spins
+)
+{
+    if(rt->is_pinned || ++*spins < SMBUS_RT_SPIN_LIMIT)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+        __asm__ volatile("yield");
+#endif
+        return;
+    }
+
+    // Rechecked once registered as a sleeper, a post in between is never missed
+    atomic_fetch_add(&rt->sleepers, 1);
+
+    if(atomic_load(&rt->state) == state)
+    {
+        syscall(SYS_futex, (int*)&rt->state, FUTEX_WAIT_PRIVATE, state, NULL, NULL, 0);
+    }
+
+    atomic_fetch_sub(&rt->sleepers, 1);
+}
+
+static inline void smbus_rt_post(
+    smbus_rt_t* rt,
+    int state
+)
+{
+    atomic_store(&rt->state, state);
+
+    if(atomic_load(&rt->sleepers) != 0)
+    {
+        syscall(SYS_futex, (int*)&rt->state, FUTEX_WAKE_PRIVATE, INT_MAX, NULL, NULL, 0);
+    }
+}
+
+bool smbus_rt_lock_memory(void)
+{
+    bool res = true;
+
+    pthread_mutex_lock(&smbus_rt_memory_lock);
+
+    // MCL_FUTURE also covers worker stacks allocated later
+    if(smbus_rt_memory_users == 0 && mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+    {
+        res = false;
+    }
+    else
+    {
+        ++smbus_rt_memory_users;
+    }
+
+    pthread_mutex_unlock(&smbus_rt_memory_lock);
+
+    return res;
+}
+
+void smbus_rt_unlock_memory(void)
+{
+    pthread_mutex_lock(&smbus_rt_memory_lock);
+
+    if(--smbus_rt_memory_users == 0)
+    {
+        munlockall();
+    }
+
+    pthread_mutex_unlock(&smbus_rt_memory_lock);
+}
+
+void smbus_rt_destroy(
+    smbus_rt_t* rt
+)
+{
+    if(rt->is_memory_locked)
+    {
+        smbus_rt_unlock_memory();
+    }
+
+    free(rt);
+}
+
+void smbus_rt_prefault_stack(
+    size_t stack_size
+)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    volatile uint8_t* stack = alloca(stack_size);
+
+    for(size_t i = 0; i < stack_size; i += page_size)
+    {
+        stack[i] = 0;
+    }
+}
+
+void* smbus_rt_worker(
+    void* arg
+)
+{
+    smbus_rt_t* rt = (smbus_rt_t*)arg;
+    unsigned spins = 0;
+
+    smbus_rt_prefault_stack(rt->stack_size - SMBUS_RT_STACK_MARGIN);
+
+    smbus_rt_post(rt, SMBUS_RT_IDLE);
+
+    // A pinned worker busy polls, keeping the hot path free of any syscall but the transfer
+    for(;;)
+    {
+        int state = atomic_load_explicit(&rt->state, memory_order_acquire);
+
+        if(state == SMBUS_RT_STOP)
+        {
+            break;
+        }
+
+        if(state != SMBUS_RT_REQUEST)
+        {
+            smbus_rt_relax(rt, state, &spins);
+            continue;
+        }
+
+        spins = 0;
+
+        rt->res = smbus_backend_ioctl(rt->smbus_inst, rt->request, rt->arg);
+        rt->error = errno;
+
+        smbus_rt_post(rt, SMBUS_RT_DONE);
+    }
+
+    return NULL;
+}
+
+bool smbus_rt_start(
+    smbus_handle_t smbus_handle,
+    const smbus_rt_config_t* config
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    smbus_rt_config_t defaults = {
+        .priority = 0,
+        .cpu = -1,
+        .stack_size = SMBUS_RT_STACK_DEFAULT,
+        .lock_memory = true,
+    };
+    smbus_rt_t* rt = NULL;
+    pthread_attr_t attr;
+    int res = 0;
+
+    if(smbus_inst->rt != NULL)
+    {
+        errno = EBUSY;
+        return false;
+    }
+
+    if(config == NULL)
+    {
+        config = &defaults;
+    }
+
+    if(posix_memalign((void**)&rt, SMBUS_RT_CACHE_LINE, sizeof(smbus_rt_t)) != 0)
+    {
+        errno = ENOMEM;
+        return false;
+    }
+
+    memset(rt, 0, sizeof(smbus_rt_t));
+    atomic_init(&rt->state, SMBUS_RT_STARTING);
+    atomic_init(&rt->sleepers, 0);
+    rt->smbus_inst = smbus_inst;
+    rt->is_pinned = (config->cpu >= 0);
+    rt->stack_size = (config->stack_size != 0) ? config->stack_size : SMBUS_RT_STACK_DEFAULT;
+
+    if(rt->stack_size < (size_t)PTHREAD_STACK_MIN + SMBUS_RT_STACK_MARGIN)
+    {
+        rt->stack_size = (size_t)PTHREAD_STACK_MIN + SMBUS_RT_STACK_MARGIN;
+    }
+
+    if(config->lock_memory)
+    {
+        if(!smbus_rt_lock_memory())
+        {
+            free(rt);
+            return false;
+        }
+
+        rt->is_memory_locked = true;
+    }
+
+    pthread_attr_init(&attr);
+    res = pthread_attr_setstacksize(&attr, rt->stack_size);
+
+    if(res == 0 && config->priority > 0)
+    {
+        struct sched_param param = {
+            .sched_priority = config->priority,
+        };
+
+        res = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+
+        if(res == 0)
+        {
+            res = pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
+        }
+
+        if(res == 0)
+        {
+            res = pthread_attr_setschedparam(&attr, &param);
+        }
+    }
+
+    if(res == 0 && config->cpu >= 0)
+    {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(config->cpu, &cpu_set);
+
+        res = pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cpu_set);
+    }
+
+    if(res == 0)
+    {
+        res = pthread_create(&rt->worker, &attr, smbus_rt_worker, rt);
+    }
+
+    pthread_attr_destroy(&attr);
+
+    if(res != 0)
+    {
+        smbus_rt_destroy(rt);
+
+        errno = res;
+        return false;
+    }
+
+    while(atomic_load_explicit(&rt->state, memory_order_acquire) == SMBUS_RT_STARTING)
+    {
+        sched_yield();
+    }
+
+    smbus_inst_lock(smbus_inst);
+    smbus_inst->rt = rt;
+    smbus_inst_unlock(smbus_inst);
+
+    return true;
+}
+
+bool smbus_rt_stop(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    // Taking the lock waits for a submission in progress
+    smbus_inst_lock(smbus_inst);
+    smbus_rt_t* rt = smbus_inst->rt;
+    smbus_inst->rt = NULL;
+    smbus_inst_unlock(smbus_inst);
+
+    if(rt == NULL)
+    {
+        return true;
+    }
+
+    smbus_rt_post(rt, SMBUS_RT_STOP);
+    pthread_join(rt->worker, NULL);
+
+    smbus_rt_destroy(rt);
+
+    return true;
+}
+
+int smbus_rt_ioctl(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg
+)
+{
+    // Submitters hold the handle lock, so the mailbox has a single producer
+    smbus_rt_t* rt = smbus_inst->rt;
+    unsigned spins = 0;
+
+    rt->request = request;
+    rt->arg = arg;
+
+    smbus_rt_post(rt, SMBUS_RT_REQUEST);
+
+    for(int state; (state = atomic_load_explicit(&rt->state, memory_order_acquire)) != SMBUS_RT_DONE; )
+    {
+        smbus_rt_relax(rt, state, &spins);
+    }
+
+    int res = rt->res;
+    errno = rt->error;
+
+    atomic_store_explicit(&rt->state, SMBUS_RT_IDLE, memory_order_relaxed);
+
+    return res;
+}
@@ -0,0 +1,239 @@
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <string.h>
+#include <errno.h>
+
+// Every register read is a write + read message pair
+#define SMBUS_UPDATE_CHUNK_MAX (I2C_RDWR_IOCTL_MAX_MSGS / 2)
+
+static bool smbus_update_chunk(
+    smbus_inst_t* smbus_inst,
+    smbus_update_t* updates,
+    size_t update_count
+);
+
+static bool smbus_update_single(
+    smbus_inst_t* smbus_inst,
+    smbus_update_t* update
+);
+
+static unsigned smbus_update_command_type(
+    smbus_update_t* update
+);
+
+static uint16_t smbus_update_apply(
+    smbus_update_t* update,
+    uint16_t current
+);
+
+bool smbus_update_bits(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint8_t mask,
+    uint8_t value
+)
+{
+    smbus_update_t update = {
+        .command = command,
+        .is_word = false,
+        .mask = mask,
+        .value = value,
+    };
+
+    return smbus_update_group(smbus_handle, &update, 1);
+}
+
+bool smbus_update_word_bits(
+    smbus_handle_t smbus_handle,
+    uint8_t command,
+    uint16_t mask,
+    uint16_t value
+)
+{
+    smbus_update_t update = {
+        .command = command,
+        .is_word = true,
+        .mask = mask,
+        .value = value,
+    };
+
+    return smbus_update_group(smbus_handle, &update, 1);
+}
+
+bool smbus_update_group(
+    smbus_handle_t smbus_handle,
+    smbus_update_t* updates,
+    size_t update_count
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    bool res = true;
+
+    if(!smbus_lock(smbus_handle))
+    {
+        return false;
+    }
+
+    for(size_t i = 0; i < update_count && res; i += SMBUS_UPDATE_CHUNK_MAX)
+    {
+        size_t chunk_len = update_count - i;
+
+        if(chunk_len > SMBUS_UPDATE_CHUNK_MAX)
+        {
+            chunk_len = SMBUS_UPDATE_CHUNK_MAX;
+        }
+
+        res = smbus_update_chunk(smbus_inst, &updates[i], chunk_len);
+    }
+
+    smbus_unlock(smbus_handle);
+
+    return res;
+}
+
+unsigned smbus_update_command_type(
+    smbus_update_t* update
+)
+{
+    return update->is_word ? I2C_SMBUS_WORD_DATA : I2C_SMBUS_BYTE_DATA;
+}
+
+uint16_t smbus_update_apply(
+    smbus_update_t* update,
+    uint16_t current
+)
+{
+    return (current & ~update->mask) | (update->value & update->mask);
+}
+
+bool smbus_update_single(
+    smbus_inst_t* smbus_inst,
+    smbus_update_t* update
+)
+{
+    unsigned command_type = smbus_update_command_type(update);
+    union i2c_smbus_data data;
+
+    // Straight to the bus, a single-flight result may predate the last write
+    if(smbus_bus_access(smbus_inst, command_type, I2C_SMBUS_READ, update->command, &data) < 0)
+    {
+        return false;
+    }
+
+    uint16_t current = update->is_word ? data.word : data.byte;
+    uint16_t next = smbus_update_apply(update, current);
+
+    update->is_changed = (next != current);
+
+    if(!update->is_changed)
+    {
+        return true;
+    }
+
+    if(update->is_word)
+    {
+        data.word = next;
+    }
+    else
+    {
+        data.byte = next;
+    }
+
+    return smbus_bus_access(smbus_inst, command_type, I2C_SMBUS_WRITE, update->command, &data) >= 0;
+}
+
+bool smbus_update_chunk(
+    smbus_inst_t* smbus_inst,
+    smbus_update_t* updates,
+    size_t update_count
+)
+{
+    smbus_emul_t emuls[SMBUS_UPDATE_CHUNK_MAX];
+    smbus_emul_t* write_emuls = emuls;
+    union i2c_smbus_data data;
+    size_t write_count = 0;
+
+    // Without plain I2C each leg is a separate SMBus transfer, still under the lock
+    if((smbus_inst->func_flags & I2C_FUNC_I2C) == 0)
+    {
+        for(size_t i = 0; i < update_count; ++i)
+        {
+            if(!smbus_update_single(smbus_inst, &updates[i]))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    for(size_t i = 0; i < update_count; ++i)
+    {
+        if(smbus_emul_prepare(
+            &emuls[i],
+            smbus_inst->slave_address,
+            smbus_inst->is_pec_enabled,
+            smbus_update_command_type(&updates[i]),
+            I2C_SMBUS_READ,
+            updates[i].command,
+            &data) < 0)
+        {
+            return false;
+        }
+    }
+
+    if(smbus_emul_batch(smbus_inst, emuls, update_count) < 0)
+    {
+        return false;
+    }
+
+    // Completed read slots are reused for the writes, in place
+    for(size_t i = 0; i < update_count; ++i)
+    {
+        if(smbus_emul_complete(smbus_inst, &emuls[i], &data) < 0)
+        {
+            return false;
+        }
+
+        uint16_t current = updates[i].is_word ? data.word : data.byte;
+        uint16_t next = smbus_update_apply(&updates[i], current);
+
+        updates[i].is_changed = (next != current);
+
+        if(!updates[i].is_changed)
+        {
+            continue;
+        }
+
+        if(updates[i].is_word)
+        {
+            data.word = next;
+        }
+        else
+        {
+            data.byte = next;
+        }
+
+        if(smbus_emul_prepare(
+            &write_emuls[write_count],
+            smbus_inst->slave_address,
+            smbus_inst->is_pec_enabled,
+            smbus_update_command_type(&updates[i]),
+            I2C_SMBUS_WRITE,
+            updates[i].command,
+            &data) < 0)
+        {
+            return false;
+        }
+
+        ++write_count;
+    }
+
+    if(write_count > 0 && smbus_emul_batch(smbus_inst, write_emuls, write_count) < 0)
+    {
+        return false;
+    }
+
+    return true;
+}
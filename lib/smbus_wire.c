@@ -0,0 +1,337 @@
+#include <smbus/smbus.h>
+#include <smbus_inst.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+
+// 8 data bits and the ACK
+#define SMBUS_WIRE_BYTE_BITS 9
+// START or repeated START, and STOP, about one SCL period each
+#define SMBUS_WIRE_START_BITS 1
+#define SMBUS_WIRE_STOP_BITS 1
+
+static uint64_t smbus_wire_ns(
+    uint64_t bits,
+    uint32_t clock_hz
+);
+
+static uint32_t smbus_wire_command_bits(
+    bool is_write,
+    unsigned length,
+    bool has_count,
+    bool has_pec
+);
+
+static uint32_t smbus_wire_smbus_bits(
+    smbus_inst_t* smbus_inst,
+    struct i2c_smbus_ioctl_data* args
+);
+
+static uint32_t smbus_wire_rdwr_bits(
+    smbus_inst_t* smbus_inst,
+    struct i2c_rdwr_ioctl_data* rdwr
+);
+
+void smbus_wire_init(
+    smbus_wire_t* wire
+)
+{
+    memset(wire, 0, sizeof(smbus_wire_t));
+
+    wire->clock_hz = SMBUS_CLOCK_HZ_DEFAULT;
+    wire->start_ns = smbus_wire_now();
+}
+
+uint64_t smbus_wire_now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+uint64_t smbus_wire_ns(
+    uint64_t bits,
+    uint32_t clock_hz
+)
+{
+    return bits * 1000000000ULL / clock_hz;
+}
+
+uint32_t smbus_wire_command_bits(
+    bool is_write,
+    unsigned length,
+    bool has_count,
+    bool has_pec
+)
+{
+    // START, address and command byte
+    uint32_t bits = SMBUS_WIRE_START_BITS + 2 * SMBUS_WIRE_BYTE_BITS;
+
+    // Reads turn the bus around with a repeated START and the read address
+    if(!is_write)
+    {
+        bits += SMBUS_WIRE_START_BITS + SMBUS_WIRE_BYTE_BITS;
+    }
+
+    bits += (length + (has_count ? 1 : 0) + (has_pec ? 1 : 0)) * SMBUS_WIRE_BYTE_BITS;
+
+    return bits + SMBUS_WIRE_STOP_BITS;
+}
+
+uint32_t smbus_wire_smbus_bits(
+    smbus_inst_t* smbus_inst,
+    struct i2c_smbus_ioctl_data* args
+)
+{
+    bool is_write = (args->read_write == I2C_SMBUS_WRITE);
+    bool has_pec = smbus_inst->is_pec_enabled;
+
+    switch(args->size)
+    {
+        case I2C_SMBUS_QUICK:
+            return SMBUS_WIRE_START_BITS + SMBUS_WIRE_BYTE_BITS + SMBUS_WIRE_STOP_BITS;
+
+        case I2C_SMBUS_BYTE:
+            return SMBUS_WIRE_START_BITS + (2 + (has_pec ? 1 : 0)) * SMBUS_WIRE_BYTE_BITS + SMBUS_WIRE_STOP_BITS;
+
+        case I2C_SMBUS_BYTE_DATA:
+            return smbus_wire_command_bits(is_write, 1, false, has_pec);
+
+        case I2C_SMBUS_WORD_DATA:
+            return smbus_wire_command_bits(is_write, 2, false, has_pec);
+
+        case I2C_SMBUS_PROC_CALL:
+            return smbus_wire_command_bits(false, 2, false, has_pec) + 2 * SMBUS_WIRE_BYTE_BITS;
+
+        case I2C_SMBUS_BLOCK_DATA:
+            return smbus_wire_command_bits(is_write, args->data->block[0], true, has_pec);
+
+        // The request is overwritten by the response, count both as long as the response
+        case I2C_SMBUS_BLOCK_PROC_CALL:
+            return smbus_wire_command_bits(false, 2 * args->data->block[0] + 1, true, has_pec);
+
+        // I2C block transfers never carry a PEC
+        case I2C_SMBUS_I2C_BLOCK_BROKEN:
+        case I2C_SMBUS_I2C_BLOCK_DATA:
+            return smbus_wire_command_bits(is_write, args->data->block[0], false, false);
+    }
+
+    return 0;
+}
+
+uint32_t smbus_wire_rdwr_bits(
+    smbus_inst_t* smbus_inst,
+    struct i2c_rdwr_ioctl_data* rdwr
+)
+{
+    uint32_t bits = 0;
+
+    for(unsigned i = 0; i < rdwr->nmsgs; ++i)
+    {
+        struct i2c_msg* msg = &rdwr->msgs[i];
+        unsigned length = msg->len;
+
+        if(i == 0 || (msg->flags & I2C_M_NOSTART) == 0)
+        {
+            bits += SMBUS_WIRE_START_BITS + SMBUS_WIRE_BYTE_BITS;
+
+            if(msg->flags & I2C_M_TEN)
+            {
+                bits += SMBUS_WIRE_BYTE_BITS;
+            }
+        }
+
+        // The count byte is left in the buffer, the PEC follows the block
+        if(msg->flags & I2C_M_RECV_LEN)
+        {
+            length = 1 + msg->buf[0] + (smbus_inst->is_pec_enabled ? 1 : 0);
+        }
+
+        bits += length * SMBUS_WIRE_BYTE_BITS;
+    }
+
+    return bits + SMBUS_WIRE_STOP_BITS;
+}
+
+void smbus_wire_account(
+    smbus_inst_t* smbus_inst,
+    unsigned long request,
+    void* arg,
+    int res,
+    uint64_t start_ns
+)
+{
+    smbus_wire_t* wire = &smbus_inst->wire;
+    // A failed transfer is counted as a NACKed address
+    uint32_t bits = SMBUS_WIRE_START_BITS + SMBUS_WIRE_BYTE_BITS + SMBUS_WIRE_STOP_BITS;
+
+    if(res >= 0)
+    {
+        bits = (request == I2C_SMBUS) ?
+            smbus_wire_smbus_bits(smbus_inst, (struct i2c_smbus_ioctl_data*)arg) :
+            smbus_wire_rdwr_bits(smbus_inst, (struct i2c_rdwr_ioctl_data*)arg);
+    }
+
+    ++wire->transfers;
+    wire->wire_bits += bits;
+    wire->wire_ns += smbus_wire_ns(bits, wire->clock_hz);
+    wire->busy_ns += smbus_wire_now() - start_ns;
+}
+
+bool smbus_set_bus_clock(
+    smbus_handle_t smbus_handle,
+    uint32_t clock_hz
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    if(clock_hz == 0)
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    smbus_inst_lock(smbus_inst);
+    smbus_inst->wire.clock_hz = clock_hz;
+    smbus_inst_unlock(smbus_inst);
+
+    return true;
+}
+
+uint32_t smbus_get_bus_clock(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    return smbus_inst->wire.clock_hz;
+}
+
+bool smbus_get_bus_stats(
+    smbus_handle_t smbus_handle,
+    smbus_bus_stats_t* stats
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    smbus_inst_lock(smbus_inst);
+    smbus_wire_t wire = smbus_inst->wire;
+    smbus_inst_unlock(smbus_inst);
+
+    memset(stats, 0, sizeof(smbus_bus_stats_t));
+
+    stats->transfers = wire.transfers;
+    stats->wire_bits = wire.wire_bits;
+    stats->wire_ns = wire.wire_ns;
+    stats->busy_ns = wire.busy_ns;
+    stats->elapsed_ns = smbus_wire_now() - wire.start_ns;
+    stats->idle_ns = (stats->elapsed_ns > wire.busy_ns) ? stats->elapsed_ns - wire.busy_ns : 0;
+
+    if(stats->elapsed_ns != 0)
+    {
+        stats->occupancy = (double)wire.wire_ns / stats->elapsed_ns;
+    }
+
+    if(wire.busy_ns != 0)
+    {
+        stats->efficiency = (double)wire.wire_ns / wire.busy_ns;
+    }
+
+    return true;
+}
+
+bool smbus_reset_bus_stats(
+    smbus_handle_t smbus_handle
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+
+    smbus_inst_lock(smbus_inst);
+
+    uint32_t clock_hz = smbus_inst->wire.clock_hz;
+    smbus_wire_init(&smbus_inst->wire);
+    smbus_inst->wire.clock_hz = clock_hz;
+
+    smbus_inst_unlock(smbus_inst);
+
+    return true;
+}
+
+bool smbus_plan_schedule(
+    smbus_handle_t smbus_handle,
+    const smbus_poll_t* polls,
+    size_t poll_count,
+    smbus_plan_t* plan
+)
+{
+    SMBUS_HANDLE_CHECK(smbus_handle);
+    smbus_inst_t* smbus_inst = (smbus_inst_t*)smbus_handle;
+    double wire_ns_per_s = 0;
+    double busy_ns_per_s = 0;
+    uint32_t min_period_us = 0;
+
+    if(plan == NULL || (poll_count != 0 && polls == NULL))
+    {
+        errno = EINVAL;
+        return false;
+    }
+
+    smbus_inst_lock(smbus_inst);
+    smbus_wire_t wire = smbus_inst->wire;
+    bool is_pec_enabled = smbus_inst->is_pec_enabled;
+    smbus_inst_unlock(smbus_inst);
+
+    // Driver and scheduling cost of a transfer, as measured on this handle
+    uint64_t overhead_ns = 0;
+
+    if(wire.transfers != 0 && wire.busy_ns > wire.wire_ns)
+    {
+        overhead_ns = (wire.busy_ns - wire.wire_ns) / wire.transfers;
+    }
+
+    memset(plan, 0, sizeof(smbus_plan_t));
+
+    for(size_t i = 0; i < poll_count; ++i)
+    {
+        const smbus_poll_t* poll = &polls[i];
+
+        if(poll->is_block && poll->length > SMBUS_BLOCK_MAX)
+        {
+            errno = EINVAL;
+            return false;
+        }
+
+        if(poll->period_us == 0)
+        {
+            continue;
+        }
+
+        // Byte, word and block commands carry the PEC, dword and qword I2C block transfers do not
+        bool has_pec = is_pec_enabled && (poll->is_block || poll->length <= 2);
+        uint32_t bits = smbus_wire_command_bits(poll->is_write, poll->length, poll->is_block, has_pec);
+        uint64_t transfer_ns = smbus_wire_ns(bits, wire.clock_hz);
+        double rate = 1000000.0 / poll->period_us;
+
+        plan->transfers_per_s += rate;
+        wire_ns_per_s += transfer_ns * rate;
+        busy_ns_per_s += (transfer_ns + overhead_ns) * rate;
+        plan->burst_ns += transfer_ns + overhead_ns;
+
+        if(min_period_us == 0 || poll->period_us < min_period_us)
+        {
+            min_period_us = poll->period_us;
+        }
+    }
+
+    plan->wire_ns_per_s = wire_ns_per_s;
+    plan->busy_ns_per_s = busy_ns_per_s;
+    plan->occupancy = busy_ns_per_s / 1000000000.0;
+    plan->fits = (plan->occupancy <= 1.0) && (plan->burst_ns <= (uint64_t)min_period_us * 1000);
+
+    return true;
+}